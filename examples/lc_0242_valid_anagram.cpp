@@ -6,8 +6,7 @@
 using namespace std;
 
 bool isAnagram(string s, string t) {
-    return bykey::count_by(s, [](char c) { return c; }) ==
-           bykey::count_by(t, [](char c) { return c; });
+    return bykey::equal_counts_by(s, t, [](char c) { return c; });
 }
 
 int main() {
@@ -1,4 +1,3 @@
-#include <algorithm>
 #include <cassert>
 #include <vector>
 
@@ -7,20 +6,8 @@
 using namespace std;
 
 vector<int> arrayRankTransform(vector<int>& arr) {
-    vector<int> uniq = arr;
-    sort(uniq.begin(), uniq.end());
-    uniq.erase(unique(uniq.begin(), uniq.end()), uniq.end());
-
-    auto rank = bykey::index_by(
-        uniq,
-        [](int x) { return x; },
-        [next = 1](int) mutable { return next++; }
-    );
-
-    vector<int> out;
-    out.reserve(arr.size());
-    for (int x : arr) out.push_back(rank.at(x));
-    return out;
+    auto rank = bykey::dense_rank_by(arr, [](int x) { return x; });
+    return vector<int>(rank.begin(), rank.end());
 }
 
 int main() {
@@ -2,11 +2,32 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <condition_variable>
+#include <coroutine>
 #include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
 #include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <random>
 #include <ranges>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
 #include <type_traits>
 #include <unordered_map>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 
@@ -14,6 +35,18 @@ namespace bykey {
 
 namespace detail {
 
+inline constexpr std::size_t cache_line_size = 64;
+
+constexpr std::size_t mix_hash(std::size_t h) {
+    auto x = static_cast<std::uint64_t>(h);
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return static_cast<std::size_t>(x);
+}
+
 template <class Map>
 constexpr void try_reserve(Map& m, std::size_t n) {
     if constexpr (requires(Map& mm, std::size_t size) { mm.reserve(size); }) {
@@ -44,6 +77,36 @@ struct sum_traits {
     void combine(T& acc, Value&& v) const {
         acc += static_cast<T>(std::forward<Value>(v));
     }
+
+    void merge(T& into, T&& from) const { into += from; }
+};
+
+template <class Bucket>
+struct append_traits {
+    auto identity() const -> Bucket { return Bucket{}; }
+
+    template <class Value>
+    void combine(Bucket& bucket, Value&& v) const {
+        bucket.push_back(std::forward<Value>(v));
+    }
+
+    void merge(Bucket& into, Bucket&& from) const {
+        into.insert(into.end(), std::make_move_iterator(from.begin()), std::make_move_iterator(from.end()));
+    }
+};
+
+struct count_traits {
+    auto identity() const -> std::size_t { return 0; }
+
+    template <class Value>
+    void combine(std::size_t& acc, Value&&) const { ++acc; }
+
+    void merge(std::size_t& into, std::size_t&& from) const { into += from; }
+};
+
+struct unit_projection {
+    template <class T>
+    constexpr auto operator()(T const&) const noexcept -> int { return 0; }
 };
 
 template <class Traits, class Acc>
@@ -51,6 +114,35 @@ concept has_finalize = requires(Traits const& traits, Acc const& acc) {
     traits.finalize(acc);
 };
 
+template <class Traits, class Acc>
+concept has_merge = requires(Traits const& traits, Acc& into, Acc&& from) {
+    traits.merge(into, std::move(from));
+};
+
+template <class Map>
+concept columnar_result_map = requires(Map const& m) {
+    m.keys();
+    m.values();
+};
+
+template <class Traits, class Map>
+auto finalize_map(Traits const& traits, Map accs) {
+    using Acc = typename Map::mapped_type;
+    if constexpr (!has_finalize<Traits, Acc>) {
+        return accs;
+    } else if constexpr (columnar_result_map<Map>) {
+        return std::move(accs).transform_values([&](Acc const& acc) { return traits.finalize(acc); });
+    } else {
+        using Result = std::decay_t<decltype(traits.finalize(std::declval<Acc const&>()))>;
+        std::unordered_map<typename Map::key_type, Result, typename Map::hasher, typename Map::key_equal> out;
+        try_reserve(out, accs.size());
+        for (auto& [k, acc] : accs) {
+            out.emplace(k, traits.finalize(acc));
+        }
+        return out;
+    }
+}
+
 template <class Range>
 constexpr auto size_hint(Range&& r, std::size_t expected) {
     if (expected) return expected;
@@ -85,8 +177,9 @@ struct basic_transform_traits {
     }
 };
 
-template <class Range, class KeyProj, class ValProj, class Traits>
-auto transform_reduce_by_impl(Range&& r,
+template <class Policy, class Range, class KeyProj, class ValProj, class Traits>
+auto transform_reduce_by_impl(Policy,
+                              Range&& r,
                               KeyProj key,
                               ValProj value,
                               Traits traits,
@@ -95,7 +188,7 @@ auto transform_reduce_by_impl(Range&& r,
     using K   = std::decay_t<std::invoke_result_t<KeyProj&, Ref>>;
     using Acc = std::decay_t<decltype(traits.identity())>;
 
-    std::unordered_map<K, Acc> accs;
+    typename Policy::template map_type<K, Acc> accs;
     try_reserve(accs, size_hint(r, expected_unique));
 
     auto key_proj    = std::move(key);
@@ -109,16 +202,279 @@ auto transform_reduce_by_impl(Range&& r,
         traits_copy.combine(it->second, std::move(value_copy));
     }
 
-    if constexpr (has_finalize<Traits, Acc>) {
-        using Result = std::decay_t<decltype(traits_copy.finalize(std::declval<Acc const&>()))>;
-        std::unordered_map<K, Result> out;
-        try_reserve(out, accs.size());
-        for (auto& [k, acc] : accs) {
-            out.emplace(k, traits_copy.finalize(acc));
+    return Policy::finish(finalize_map(traits_copy, std::move(accs)));
+}
+
+template <class T>
+class chunk_queue {
+public:
+    explicit chunk_queue(std::size_t capacity) : capacity_(std::max<std::size_t>(capacity, 1)) {}
+
+    // Returns false once the queue is closed; the chunk is dropped.
+    auto push(std::vector<T> chunk) -> bool {
+        std::unique_lock lock(mutex_);
+        not_full_.wait(lock, [&] { return chunks_.size() < capacity_ || closed_; });
+        if (closed_) return false;
+        chunks_.push_back(std::move(chunk));
+        not_empty_.notify_one();
+        return true;
+    }
+
+    auto pop() -> std::optional<std::vector<T>> {
+        std::unique_lock lock(mutex_);
+        not_empty_.wait(lock, [&] { return !chunks_.empty() || closed_; });
+        if (chunks_.empty()) return std::nullopt;
+        auto chunk = std::move(chunks_.front());
+        chunks_.pop_front();
+        not_full_.notify_one();
+        return chunk;
+    }
+
+    void close() {
+        std::lock_guard lock(mutex_);
+        closed_ = true;
+        not_empty_.notify_all();
+        not_full_.notify_all();
+    }
+
+private:
+    std::size_t capacity_;
+    std::mutex mutex_;
+    std::condition_variable not_empty_;
+    std::condition_variable not_full_;
+    std::deque<std::vector<T>> chunks_;
+    bool closed_ = false;
+};
+
+// Open-addressing set with linear probing: one control byte per slot (empty
+// or a 7-bit hash tag) next to an array of keys, grown at 7/8 load.
+template <class K, class Hash = std::hash<K>, class KeyEqual = std::equal_to<K>>
+class flat_set {
+public:
+    flat_set() = default;
+
+    flat_set(flat_set&& other) noexcept
+        : ctrl_(std::move(other.ctrl_)),
+          slots_(std::exchange(other.slots_, nullptr)),
+          size_(std::exchange(other.size_, 0)) {}
+
+    flat_set& operator=(flat_set&& other) noexcept {
+        if (this != &other) {
+            release();
+            ctrl_  = std::move(other.ctrl_);
+            slots_ = std::exchange(other.slots_, nullptr);
+            size_  = std::exchange(other.size_, 0);
         }
-        return out;
-    } else {
-        return accs;
+        return *this;
+    }
+
+    flat_set(flat_set const&) = delete;
+    flat_set& operator=(flat_set const&) = delete;
+
+    ~flat_set() { release(); }
+
+    void reserve(std::size_t n) {
+        auto wanted = std::bit_ceil(std::max<std::size_t>(n + n / 7 + 1, 8));
+        if (wanted > ctrl_.size()) rehash(wanted);
+    }
+
+    // Returns true when the key was not present yet.
+    auto insert(K key) -> bool {
+        if ((size_ + 1) * 8 > ctrl_.size() * 7) rehash(std::max<std::size_t>(ctrl_.size() * 2, 8));
+        auto h   = mix_hash(Hash{}(key));
+        auto tag = tag_of(h);
+        auto idx = find_slot(key, h, tag);
+        if (ctrl_[idx] == tag) return false;
+        ctrl_[idx] = tag;
+        std::construct_at(slots_ + idx, std::move(key));
+        ++size_;
+        return true;
+    }
+
+    auto contains(K const& key) const -> bool {
+        if (!size_) return false;
+        auto h = mix_hash(Hash{}(key));
+        return ctrl_[find_slot(key, h, tag_of(h))] != 0;
+    }
+
+    void clear() {
+        for (std::size_t i = 0; i < ctrl_.size(); ++i) {
+            if (ctrl_[i]) std::destroy_at(slots_ + i);
+        }
+        std::fill(ctrl_.begin(), ctrl_.end(), std::uint8_t{0});
+        size_ = 0;
+    }
+
+    auto size() const -> std::size_t { return size_; }
+
+private:
+    static auto tag_of(std::size_t h) -> std::uint8_t {
+        return static_cast<std::uint8_t>(0x80u | (static_cast<std::uint64_t>(h) >> 57));
+    }
+
+    auto find_slot(K const& key, std::size_t h, std::uint8_t tag) const -> std::size_t {
+        auto mask = ctrl_.size() - 1;
+        auto idx  = h & mask;
+        while (ctrl_[idx] && !(ctrl_[idx] == tag && KeyEqual{}(slots_[idx], key))) idx = (idx + 1) & mask;
+        return idx;
+    }
+
+    // Both new arrays are allocated before anything is swapped, so a failed
+    // allocation leaves the set unchanged.
+    void rehash(std::size_t capacity) {
+        std::vector<std::uint8_t> new_ctrl(capacity, 0);
+        auto* new_slots = std::allocator<K>{}.allocate(capacity);
+        auto old_ctrl   = std::exchange(ctrl_, std::move(new_ctrl));
+        auto* old_slots = std::exchange(slots_, new_slots);
+        for (std::size_t i = 0; i < old_ctrl.size(); ++i) {
+            if (!old_ctrl[i]) continue;
+            auto h   = mix_hash(Hash{}(old_slots[i]));
+            auto idx = h & (capacity - 1);
+            while (ctrl_[idx]) idx = (idx + 1) & (capacity - 1);
+            ctrl_[idx] = old_ctrl[i];
+            std::construct_at(slots_ + idx, std::move(old_slots[i]));
+            std::destroy_at(old_slots + i);
+        }
+        if (old_slots) std::allocator<K>{}.deallocate(old_slots, old_ctrl.size());
+    }
+
+    void release() {
+        if (!slots_) return;
+        clear();
+        std::allocator<K>{}.deallocate(slots_, ctrl_.size());
+        slots_ = nullptr;
+    }
+
+    std::vector<std::uint8_t> ctrl_;
+    K* slots_ = nullptr;
+    std::size_t size_ = 0;
+};
+
+inline auto default_worker_count() -> std::size_t {
+    return std::max<std::size_t>(std::thread::hardware_concurrency(), 1);
+}
+
+// Counts tasks submitted to an executor and lets the submitter block until all
+// of them finished; the first exception thrown by a task is rethrown by wait().
+// Tasks sit in the group's own queue and each executor submission only claims
+// the next one, so wait() can run not-yet-started tasks on the calling thread.
+// That keeps nested parallel algorithms on one pool from deadlocking when every
+// pool thread is itself waiting. If the executor refuses a task, run() drops
+// it and rethrows; tasks accepted earlier still need a wait().
+class task_group {
+public:
+    task_group() : state_(std::make_shared<state>()) {}
+
+    template <class Executor, class F>
+    void run(Executor& ex, F f) {
+        {
+            std::lock_guard lock(state_->mutex);
+            state_->queued.emplace_back(std::move(f));
+            ++state_->pending;
+        }
+        try {
+            ex.execute([st = state_] { st->run_one(); });
+        } catch (...) {
+            // Every earlier submission claims an earlier task, so the refused
+            // one is still last in the queue.
+            std::lock_guard lock(state_->mutex);
+            if (!state_->queued.empty()) {
+                state_->queued.pop_back();
+                if (--state_->pending == 0) state_->done.notify_all();
+            }
+            throw;
+        }
+    }
+
+    void wait() {
+        while (state_->run_one()) {}
+        std::unique_lock lock(state_->mutex);
+        state_->done.wait(lock, [&] { return state_->pending == 0; });
+        if (state_->error) std::rethrow_exception(std::exchange(state_->error, nullptr));
+    }
+
+private:
+    struct state {
+        std::mutex mutex;
+        std::condition_variable done;
+        std::deque<std::function<void()>> queued;
+        std::size_t pending = 0;
+        std::exception_ptr error;
+
+        // Runs the oldest task nobody has claimed yet; false when none is left.
+        auto run_one() -> bool {
+            std::function<void()> task;
+            {
+                std::lock_guard lock(mutex);
+                if (queued.empty()) return false;
+                task = std::move(queued.front());
+                queued.pop_front();
+            }
+            try {
+                task();
+            } catch (...) {
+                std::lock_guard lock(mutex);
+                if (!error) error = std::current_exception();
+            }
+            std::lock_guard lock(mutex);
+            if (--pending == 0) done.notify_all();
+            return true;
+        }
+    };
+
+    std::shared_ptr<state> state_;
+};
+
+// Runs fn(i) for every i in [0, n) as separate tasks and waits for all of them.
+template <class Executor, class F>
+void parallel_for(Executor& ex, std::size_t n, F fn) {
+    task_group group;
+    try {
+        for (std::size_t i = 0; i < n; ++i) {
+            group.run(ex, [&fn, i] { fn(i); });
+        }
+    } catch (...) {
+        // Accepted tasks reference fn; let them finish before unwinding.
+        try {
+            group.wait();
+        } catch (...) {
+        }
+        throw;
+    }
+    group.wait();
+}
+
+template <class K>
+concept radix_sortable = std::integral<K> && !std::same_as<K, bool>;
+
+template <radix_sortable K>
+constexpr auto radix_key(K k) -> std::make_unsigned_t<K> {
+    using U = std::make_unsigned_t<K>;
+    auto u = static_cast<U>(k);
+    if constexpr (std::is_signed_v<K>) u ^= static_cast<U>(U{1} << (sizeof(K) * 8 - 1));
+    return u;
+}
+
+// LSD radix sort on (key, payload) pairs, one byte per pass. All digit
+// histograms come from a single read, and passes whose digit is constant
+// across the input are skipped.
+template <radix_sortable K, class Payload>
+void radix_sort_pairs(std::vector<std::pair<K, Payload>>& v) {
+    constexpr std::size_t passes = sizeof(K);
+    std::vector<std::array<std::size_t, 256>> counts(passes);
+    for (auto const& p : v) {
+        auto u = radix_key(p.first);
+        for (std::size_t d = 0; d < passes; ++d) ++counts[d][(u >> (8 * d)) & 0xff];
+    }
+
+    std::vector<std::pair<K, Payload>> buffer(v.size());
+    for (std::size_t d = 0; d < passes; ++d) {
+        auto& c = counts[d];
+        if (std::ranges::find(c, v.size()) != c.end()) continue;
+        std::size_t sum = 0;
+        for (auto& n : c) sum += std::exchange(n, sum);
+        for (auto& p : v) buffer[c[(radix_key(p.first) >> (8 * d)) & 0xff]++] = std::move(p);
+        v.swap(buffer);
     }
 }
 
@@ -136,19 +492,276 @@ struct partition_result {
     std::vector<Value> trues;
 };
 
+// ---- columnar results --------------------------------------------------
+
+template <class K, class V>
+struct column_result {
+    std::vector<K> keys;
+    std::vector<V> values;
+};
+
+template <class K, class V, class Hash = std::hash<K>, class KeyEqual = std::equal_to<K>>
+class columnar_map {
+    template <bool Const>
+    class basic_iterator {
+        using owner = std::conditional_t<Const, columnar_map const, columnar_map>;
+
+    public:
+        using difference_type = std::ptrdiff_t;
+        using value_type      = std::pair<K, V>;
+        using reference       = std::pair<K const&, std::conditional_t<Const, V const&, V&>>;
+
+        struct pointer {
+            reference ref;
+            auto operator->() -> reference* { return &ref; }
+        };
+
+        basic_iterator() = default;
+        basic_iterator(owner* m, std::size_t i) : m_(m), i_(i) {}
+
+        auto operator*() const -> reference { return {m_->keys_[i_], m_->values_[i_]}; }
+        auto operator->() const -> pointer { return pointer{**this}; }
+        auto operator++() -> basic_iterator& { ++i_; return *this; }
+        auto operator++(int) -> basic_iterator { auto tmp = *this; ++i_; return tmp; }
+        auto index() const noexcept -> std::size_t { return i_; }
+
+        friend auto operator==(basic_iterator const& a, basic_iterator const& b) -> bool { return a.i_ == b.i_; }
+
+    private:
+        owner* m_ = nullptr;
+        std::size_t i_ = 0;
+    };
+
+public:
+    using key_type       = K;
+    using mapped_type    = V;
+    using hasher         = Hash;
+    using key_equal      = KeyEqual;
+    using size_type      = std::size_t;
+    using iterator       = basic_iterator<false>;
+    using const_iterator = basic_iterator<true>;
+
+    columnar_map() = default;
+    explicit columnar_map(Hash hash, KeyEqual eq = {}) : hash_(std::move(hash)), eq_(std::move(eq)) {}
+
+    auto size() const noexcept -> std::size_t { return keys_.size(); }
+    auto empty() const noexcept -> bool { return keys_.empty(); }
+
+    auto begin() -> iterator { return {this, 0}; }
+    auto end() -> iterator { return {this, keys_.size()}; }
+    auto begin() const -> const_iterator { return {this, 0}; }
+    auto end() const -> const_iterator { return {this, keys_.size()}; }
+
+    auto keys() const noexcept -> std::vector<K> const& { return keys_; }
+    auto values() const noexcept -> std::vector<V> const& { return values_; }
+    auto mutable_values() noexcept -> std::span<V> { return values_; }
+
+    // Sizes only the index, like unordered_map::reserve: algorithms pass the
+    // row count when the key count is unknown, so the key and value columns
+    // grow with the keys actually inserted.
+    void reserve(std::size_t n) {
+        if (n * 2 > slots_.size()) rehash(std::bit_ceil(std::max<std::size_t>(n * 2, 16)));
+    }
+
+    void clear() noexcept {
+        keys_.clear();
+        values_.clear();
+        std::ranges::fill(slots_, std::uint32_t{0});
+    }
+
+    auto find(K const& key) -> iterator {
+        auto pos = probe(key, hash_of(key)).second;
+        return pos ? iterator{this, pos - 1} : end();
+    }
+
+    auto find(K const& key) const -> const_iterator {
+        auto pos = probe(key, hash_of(key)).second;
+        return pos ? const_iterator{this, pos - 1} : end();
+    }
+
+    auto contains(K const& key) const -> bool { return find(key) != end(); }
+    auto count(K const& key) const -> std::size_t { return contains(key) ? 1 : 0; }
+
+    auto at(K const& key) -> V& {
+        auto it = find(key);
+        if (it == end()) throw std::out_of_range("columnar_map::at");
+        return values_[it.index()];
+    }
+
+    auto at(K const& key) const -> V const& {
+        auto it = find(key);
+        if (it == end()) throw std::out_of_range("columnar_map::at");
+        return values_[it.index()];
+    }
+
+    template <class... Args>
+    auto try_emplace(K const& key, Args&&... args) -> std::pair<iterator, bool> {
+        return emplace_impl(key, std::forward<Args>(args)...);
+    }
+
+    template <class... Args>
+    auto try_emplace(K&& key, Args&&... args) -> std::pair<iterator, bool> {
+        return emplace_impl(std::move(key), std::forward<Args>(args)...);
+    }
+
+    template <class KeyArg, class ValArg>
+    auto emplace(KeyArg&& key, ValArg&& value) -> std::pair<iterator, bool> {
+        return emplace_impl(K(std::forward<KeyArg>(key)), std::forward<ValArg>(value));
+    }
+
+    auto operator[](K const& key) -> V& { return values_[emplace_impl(key).first.index()]; }
+    auto operator[](K&& key) -> V& { return values_[emplace_impl(std::move(key)).first.index()]; }
+
+    template <class Compare = std::ranges::less>
+    void sort_by_key(Compare comp = {}) {
+        std::vector<std::uint32_t> order(keys_.size());
+        for (std::size_t i = 0; i < order.size(); ++i) order[i] = static_cast<std::uint32_t>(i);
+        std::ranges::sort(order, comp, [&](std::uint32_t i) -> K const& { return keys_[i]; });
+
+        std::vector<K> keys;
+        std::vector<V> values;
+        keys.reserve(order.size());
+        values.reserve(order.size());
+        for (auto i : order) {
+            keys.push_back(std::move(keys_[i]));
+            values.push_back(std::move(values_[i]));
+        }
+        keys_ = std::move(keys);
+        values_ = std::move(values);
+        rehash(slots_.size());
+    }
+
+    template <class F>
+    auto transform_values(F f) && {
+        using R = std::decay_t<std::invoke_result_t<F&, V&>>;
+        columnar_map<K, R, Hash, KeyEqual> out(std::move(hash_), std::move(eq_));
+        out.values_.reserve(values_.size());
+        for (auto& v : values_) out.values_.push_back(f(v));
+        out.keys_ = std::move(keys_);
+        out.slots_ = std::move(slots_);
+        values_.clear();
+        return out;
+    }
+
+    auto release() && -> column_result<K, V> {
+        slots_.clear();
+        return {std::move(keys_), std::move(values_)};
+    }
+
+private:
+    template <class, class, class, class>
+    friend class columnar_map;
+
+    auto hash_of(K const& key) const -> std::size_t { return detail::mix_hash(hash_(key)); }
+
+    auto probe(K const& key, std::size_t h) const -> std::pair<std::size_t, std::uint32_t> {
+        if (slots_.empty()) return {0, 0};
+        auto mask = slots_.size() - 1;
+        for (auto i = h & mask;; i = (i + 1) & mask) {
+            auto pos = slots_[i];
+            if (!pos || eq_(keys_[pos - 1], key)) return {i, pos};
+        }
+    }
+
+    void rehash(std::size_t capacity) {
+        if (keys_.size() >= std::numeric_limits<std::uint32_t>::max()) {
+            throw std::length_error("columnar_map: too many keys");
+        }
+        slots_.assign(capacity, 0);
+        auto mask = capacity - 1;
+        for (std::size_t pos = 0; pos < keys_.size(); ++pos) {
+            auto i = hash_of(keys_[pos]) & mask;
+            while (slots_[i]) i = (i + 1) & mask;
+            slots_[i] = static_cast<std::uint32_t>(pos + 1);
+        }
+    }
+
+    template <class KeyArg, class... Args>
+    auto emplace_impl(KeyArg&& key, Args&&... args) -> std::pair<iterator, bool> {
+        if ((keys_.size() + 1) * 2 > slots_.size()) {
+            rehash(std::max<std::size_t>(slots_.size() * 2, 16));
+        }
+        auto [slot, pos] = probe(key, hash_of(key));
+        if (pos) return {iterator{this, pos - 1}, false};
+
+        keys_.push_back(std::forward<KeyArg>(key));
+        try {
+            values_.emplace_back(std::forward<Args>(args)...);
+        } catch (...) {
+            keys_.pop_back();
+            throw;
+        }
+        slots_[slot] = static_cast<std::uint32_t>(keys_.size());
+        return {iterator{this, keys_.size() - 1}, true};
+    }
+
+    std::vector<K> keys_;
+    std::vector<V> values_;
+    std::vector<std::uint32_t> slots_;
+    [[no_unique_address]] Hash hash_{};
+    [[no_unique_address]] KeyEqual eq_{};
+};
+
+namespace result {
+
+struct hash_map_t {
+    template <class K, class V>
+    using map_type = std::unordered_map<K, V>;
+
+    template <class Map>
+    static auto finish(Map m) -> Map { return m; }
+};
+
+struct columns_t {
+    template <class K, class V>
+    using map_type = columnar_map<K, V>;
+
+    template <class Map>
+    static auto finish(Map m) -> Map { return m; }
+};
+
+struct sorted_columns_t {
+    template <class K, class V>
+    using map_type = columnar_map<K, V>;
+
+    template <class Map>
+    static auto finish(Map m) -> Map {
+        m.sort_by_key();
+        return m;
+    }
+};
+
+inline constexpr hash_map_t hash_map{};
+inline constexpr columns_t columns{};
+inline constexpr sorted_columns_t sorted_columns{};
+
+} // namespace result
+
+namespace detail {
+
+template <class Policy>
+concept result_policy = requires { typename Policy::template map_type<int, int>; };
+
+} // namespace detail
+
 // ---- core ---------------------------------------------------------------
 
-template <std::ranges::input_range R, class KeyProj>
-auto count_by(R&& r, KeyProj key, std::size_t expected_unique = 0) {
+template <detail::result_policy Policy, std::ranges::input_range R, class KeyProj>
+auto count_by(Policy, R&& r, KeyProj key, std::size_t expected_unique = 0) {
     using Ref  = std::ranges::range_reference_t<R>;
     using K    = std::decay_t<std::invoke_result_t<KeyProj&, Ref>>;
-    std::unordered_map<K, std::size_t> freq;
+    typename Policy::template map_type<K, std::size_t> freq;
 
     detail::try_reserve(freq, detail::size_hint(r, expected_unique));
 
     auto key_proj = std::move(key);
     for (auto&& x : r) ++freq[key_proj(x)];
-    return freq;
+    return Policy::finish(std::move(freq));
+}
+
+template <std::ranges::input_range R, class KeyProj>
+auto count_by(R&& r, KeyProj key, std::size_t expected_unique = 0) {
+    return count_by(result::hash_map, std::forward<R>(r), std::move(key), expected_unique);
 }
 
 template <std::ranges::input_range R, class KeyProj, class ValProj, class Map>
@@ -176,21 +789,27 @@ auto index_by_into(R&& r, KeyProj key, ValProj val, Map m, bool overwrite = true
     return m;
 }
 
-template <std::ranges::input_range R, class KeyProj, class ValProj>
-auto index_by(R&& r, KeyProj key, ValProj val, bool overwrite = true) {
+template <detail::result_policy Policy, std::ranges::input_range R, class KeyProj, class ValProj>
+auto index_by(Policy, R&& r, KeyProj key, ValProj val, bool overwrite = true) {
     using Ref = std::ranges::range_reference_t<R>;
     using K   = std::decay_t<std::invoke_result_t<KeyProj&, Ref>>;
     using V   = std::decay_t<std::invoke_result_t<ValProj&, Ref>>;
-    return index_by_into(std::forward<R>(r), std::move(key), std::move(val), std::unordered_map<K, V>{}, overwrite);
+    return Policy::finish(index_by_into(std::forward<R>(r), std::move(key), std::move(val),
+                                        typename Policy::template map_type<K, V>{}, overwrite));
 }
 
-template <std::ranges::input_range R, class KeyProj, class ValProj, class Acc, class BinOp>
-auto group_reduce_by(R&& r, KeyProj key, ValProj value, Acc init, BinOp op,
+template <std::ranges::input_range R, class KeyProj, class ValProj>
+auto index_by(R&& r, KeyProj key, ValProj val, bool overwrite = true) {
+    return index_by(result::hash_map, std::forward<R>(r), std::move(key), std::move(val), overwrite);
+}
+
+template <detail::result_policy Policy, std::ranges::input_range R, class KeyProj, class ValProj, class Acc, class BinOp>
+auto group_reduce_by(Policy, R&& r, KeyProj key, ValProj value, Acc init, BinOp op,
                      std::size_t expected_unique = 0) {
     using Ref = std::ranges::range_reference_t<R>;
     using K   = std::decay_t<std::invoke_result_t<KeyProj&, Ref>>;
 
-    std::unordered_map<K, Acc> m;
+    typename Policy::template map_type<K, Acc> m;
     detail::try_reserve(m, detail::size_hint(r, expected_unique));
 
     auto key_proj = std::move(key);
@@ -203,7 +822,14 @@ auto group_reduce_by(R&& r, KeyProj key, ValProj value, Acc init, BinOp op,
         auto [it, inserted] = m.try_emplace(key_value, init);
         op_fn(it->second, std::move(value_copy));
     }
-    return m;
+    return Policy::finish(std::move(m));
+}
+
+template <std::ranges::input_range R, class KeyProj, class ValProj, class Acc, class BinOp>
+auto group_reduce_by(R&& r, KeyProj key, ValProj value, Acc init, BinOp op,
+                     std::size_t expected_unique = 0) {
+    return group_reduce_by(result::hash_map, std::forward<R>(r), std::move(key), std::move(value),
+                           std::move(init), std::move(op), expected_unique);
 }
 
 // ---- convenience algorithms --------------------------------------------
@@ -233,39 +859,66 @@ auto group_by_into(R&& r, KeyProj key, ValProj value, Map m, std::size_t expecte
     return m;
 }
 
-template <std::ranges::input_range R, class KeyProj, class ValProj = std::identity>
-auto group_by(R&& r, KeyProj key, ValProj value = {}, std::size_t expected_unique = 0) {
+template <detail::result_policy Policy, std::ranges::input_range R, class KeyProj, class ValProj = std::identity>
+auto group_by(Policy, R&& r, KeyProj key, ValProj value = {}, std::size_t expected_unique = 0) {
     using Ref = std::ranges::range_reference_t<R>;
     using K   = std::decay_t<std::invoke_result_t<KeyProj&, Ref>>;
     using V   = std::decay_t<std::invoke_result_t<ValProj&, Ref>>;
-    return group_by_into(std::forward<R>(r), std::move(key), std::move(value), std::unordered_map<K, std::vector<V>>{}, expected_unique);
+    return Policy::finish(group_by_into(std::forward<R>(r), std::move(key), std::move(value),
+                                        typename Policy::template map_type<K, std::vector<V>>{}, expected_unique));
+}
+
+template <std::ranges::input_range R, class KeyProj, class ValProj = std::identity>
+auto group_by(R&& r, KeyProj key, ValProj value = {}, std::size_t expected_unique = 0) {
+    return group_by(result::hash_map, std::forward<R>(r), std::move(key), std::move(value), expected_unique);
+}
+
+template <detail::result_policy Policy, std::ranges::input_range R, class KeyProj, class ValProj, class Traits>
+auto transform_reduce_by(Policy policy, R&& r, KeyProj key, ValProj value, Traits traits, std::size_t expected_unique = 0) {
+    return detail::transform_reduce_by_impl(policy, std::forward<R>(r), std::move(key), std::move(value), std::move(traits), expected_unique);
+}
+
+template <detail::result_policy Policy, std::ranges::input_range R, class KeyProj, class ValProj, class Acc, class BinaryOp>
+auto transform_reduce_by(Policy policy, R&& r, KeyProj key, ValProj value, Acc init, BinaryOp combine, std::size_t expected_unique = 0) {
+    auto traits = detail::basic_transform_traits<Acc, BinaryOp>{std::move(init), std::move(combine)};
+    return detail::transform_reduce_by_impl(policy, std::forward<R>(r), std::move(key), std::move(value), std::move(traits), expected_unique);
 }
 
 template <std::ranges::input_range R, class KeyProj, class ValProj, class Traits>
 auto transform_reduce_by(R&& r, KeyProj key, ValProj value, Traits traits, std::size_t expected_unique = 0) {
-    return detail::transform_reduce_by_impl(std::forward<R>(r), std::move(key), std::move(value), std::move(traits), expected_unique);
+    return detail::transform_reduce_by_impl(result::hash_map, std::forward<R>(r), std::move(key), std::move(value), std::move(traits), expected_unique);
 }
 
 template <std::ranges::input_range R, class KeyProj, class ValProj, class Acc, class BinaryOp>
 auto transform_reduce_by(R&& r, KeyProj key, ValProj value, Acc init, BinaryOp combine, std::size_t expected_unique = 0) {
-    auto traits = detail::basic_transform_traits<Acc, BinaryOp>{std::move(init), std::move(combine)};
-    return detail::transform_reduce_by_impl(std::forward<R>(r), std::move(key), std::move(value), std::move(traits), expected_unique);
+    return transform_reduce_by(result::hash_map, std::forward<R>(r), std::move(key), std::move(value), std::move(init), std::move(combine), expected_unique);
 }
 
-template <std::ranges::input_range R, class KeyProj, class ValProj>
-auto accumulate_by(R&& r, KeyProj key, ValProj value, std::size_t expected_unique = 0) {
+template <detail::result_policy Policy, std::ranges::input_range R, class KeyProj, class ValProj>
+auto accumulate_by(Policy policy, R&& r, KeyProj key, ValProj value, std::size_t expected_unique = 0) {
     using Ref = std::ranges::range_reference_t<R>;
     using V   = std::decay_t<std::invoke_result_t<ValProj&, Ref>>;
-    return transform_reduce_by(std::forward<R>(r), std::move(key), std::move(value), detail::sum_traits<V>{}, expected_unique);
+    return transform_reduce_by(policy, std::forward<R>(r), std::move(key), std::move(value), detail::sum_traits<V>{}, expected_unique);
+}
+
+template <detail::result_policy Policy, std::ranges::input_range R, class KeyProj, class ValProj, class T>
+auto accumulate_by(Policy policy, R&& r, KeyProj key, ValProj value, T init, std::size_t expected_unique = 0) {
+    return transform_reduce_by(policy, std::forward<R>(r), std::move(key), std::move(value), std::move(init), std::plus<>{}, expected_unique);
+}
+
+template <std::ranges::input_range R, class KeyProj, class ValProj>
+auto accumulate_by(R&& r, KeyProj key, ValProj value, std::size_t expected_unique = 0) {
+    return accumulate_by(result::hash_map, std::forward<R>(r), std::move(key), std::move(value), expected_unique);
 }
 
 template <std::ranges::input_range R, class KeyProj, class ValProj, class T>
 auto accumulate_by(R&& r, KeyProj key, ValProj value, T init, std::size_t expected_unique = 0) {
-    return transform_reduce_by(std::forward<R>(r), std::move(key), std::move(value), std::move(init), std::plus<>{}, expected_unique);
+    return accumulate_by(result::hash_map, std::forward<R>(r), std::move(key), std::move(value), std::move(init), expected_unique);
 }
 
-template <std::ranges::input_range R, class KeyProj, class ValProj, class OrderProj = ValProj, class Compare = std::ranges::less>
-auto extrema_by(R&& r,
+template <detail::result_policy Policy, std::ranges::input_range R, class KeyProj, class ValProj, class OrderProj = ValProj, class Compare = std::ranges::less>
+auto extrema_by(Policy,
+                R&& r,
                 KeyProj key,
                 ValProj value,
                 OrderProj order = {},
@@ -276,7 +929,7 @@ auto extrema_by(R&& r,
     using V   = std::decay_t<std::invoke_result_t<ValProj&, Ref>>;
     using O   = std::decay_t<std::invoke_result_t<OrderProj&, Ref>>;
 
-    std::unordered_map<K, detail::extrema_state<V, O>> states;
+    typename Policy::template map_type<K, detail::extrema_state<V, O>> states;
     detail::try_reserve(states, detail::size_hint(r, expected_unique));
 
     auto key_proj   = std::move(key);
@@ -305,12 +958,33 @@ auto extrema_by(R&& r,
         }
     }
 
-    std::unordered_map<K, extrema_result<V>> out;
+    typename Policy::template map_type<K, extrema_result<V>> out;
     detail::try_reserve(out, states.size());
-    for (auto& [k, st] : states) {
+    for (auto&& [k, st] : states) {
         out.emplace(k, extrema_result<V>{st.min_value, st.max_value});
     }
-    return out;
+    return Policy::finish(std::move(out));
+}
+
+template <std::ranges::input_range R, class KeyProj, class ValProj, class OrderProj = ValProj, class Compare = std::ranges::less>
+auto extrema_by(R&& r,
+                KeyProj key,
+                ValProj value,
+                OrderProj order = {},
+                Compare comp = {},
+                std::size_t expected_unique = 0) {
+    return extrema_by(result::hash_map, std::forward<R>(r), std::move(key), std::move(value), std::move(order), std::move(comp), expected_unique);
+}
+
+template <detail::result_policy Policy, std::ranges::input_range R, class KeyProj, class ValProj, class OrderProj = ValProj, class Compare = std::ranges::less>
+auto minmax_by(Policy policy,
+               R&& r,
+               KeyProj key,
+               ValProj value,
+               OrderProj order = {},
+               Compare comp = {},
+               std::size_t expected_unique = 0) {
+    return extrema_by(policy, std::forward<R>(r), std::move(key), std::move(value), std::move(order), std::move(comp), expected_unique);
 }
 
 template <std::ranges::input_range R, class KeyProj, class ValProj, class OrderProj = ValProj, class Compare = std::ranges::less>
@@ -382,21 +1056,3291 @@ auto partition_by(R&& r, Pred pred, ValProj value = {}) {
     return out;
 }
 
-// ---- pipeline adaptors -------------------------------------------------
+// ---- distinct ----------------------------------------------------------
 
-namespace adaptors {
+namespace detail {
 
-template <class KeyProj>
-auto count(KeyProj key, std::size_t expected_unique = 0) {
-    return detail::pipeable{[key = std::move(key), expected_unique](auto&& range) {
-        return count_by(std::forward<decltype(range)>(range), key, expected_unique);
-    }};
-}
+// Holds a callable so that its owner stays assignable even when the callable
+// (e.g. a capturing lambda) is not: assignment re-constructs the value.
+template <class T>
+class assignable_box {
+public:
+    assignable_box() = default;
+    explicit assignable_box(T value) : value_(std::move(value)) {}
 
-template <class KeyProj, class ValProj = std::identity>
-auto group(KeyProj key, ValProj value = {}, std::size_t expected_unique = 0) {
-    return detail::pipeable{[key = std::move(key), value = std::move(value), expected_unique](auto&& range) {
-        return group_by(std::forward<decltype(range)>(range), key, value, expected_unique);
+    assignable_box(assignable_box const&) = default;
+    assignable_box(assignable_box&&) = default;
+
+    assignable_box& operator=(assignable_box const& other) {
+        if (this != &other) {
+            if (other.value_) value_.emplace(*other.value_);
+            else value_.reset();
+        }
+        return *this;
+    }
+
+    assignable_box& operator=(assignable_box&& other) noexcept(std::is_nothrow_move_constructible_v<T>) {
+        if (this != &other) {
+            if (other.value_) value_.emplace(std::move(*other.value_));
+            else value_.reset();
+        }
+        return *this;
+    }
+
+    auto operator*() -> T& { return *value_; }
+    auto operator*() const -> T const& { return *value_; }
+
+private:
+    std::optional<T> value_;
+};
+
+} // namespace detail
+
+// Lazy first-seen deduplication. Only the keys are retained, in a compact
+// open-addressing set that grows with the distinct keys actually seen. The set
+// lives in the view: copies start with their own empty set, and each call to
+// begin() starts a fresh pass (invalidating iterators from an earlier one).
+template <std::ranges::view V, class KeyProj>
+    requires std::ranges::input_range<V>
+class distinct_view : public std::ranges::view_interface<distinct_view<V, KeyProj>> {
+    using K = std::decay_t<std::invoke_result_t<KeyProj&, std::ranges::range_reference_t<V>>>;
+
+public:
+    class iterator {
+    public:
+        using iterator_concept = std::input_iterator_tag;
+        using difference_type  = std::ptrdiff_t;
+        using value_type       = std::ranges::range_value_t<V>;
+
+        iterator() = default;
+
+        auto operator*() const -> std::ranges::range_reference_t<V> { return *it_; }
+
+        auto operator++() -> iterator& {
+            ++it_;
+            satisfy();
+            return *this;
+        }
+
+        void operator++(int) { ++*this; }
+
+        friend auto operator==(iterator const& it, std::default_sentinel_t) -> bool { return it.at_end(); }
+
+    private:
+        friend class distinct_view;
+
+        auto at_end() const -> bool { return it_ == std::ranges::end(parent_->base_); }
+
+        iterator(distinct_view* parent, std::ranges::iterator_t<V> it) : parent_(parent), it_(std::move(it)) {
+            satisfy();
+        }
+
+        void satisfy() {
+            auto& p = *parent_;
+            while (it_ != std::ranges::end(p.base_) && !p.seen_.insert(K((*p.key_)(*it_)))) ++it_;
+        }
+
+        distinct_view* parent_ = nullptr;
+        std::ranges::iterator_t<V> it_{};
+    };
+
+    distinct_view() = default;
+
+    distinct_view(V base, KeyProj key) : base_(std::move(base)), key_(std::move(key)) {}
+
+    distinct_view(distinct_view const& other) : base_(other.base_), key_(other.key_) {}
+    distinct_view(distinct_view&& other) : base_(std::move(other.base_)), key_(std::move(other.key_)) {}
+
+    distinct_view& operator=(distinct_view const& other) {
+        base_ = other.base_;
+        key_  = other.key_;
+        seen_ = {};
+        return *this;
+    }
+
+    distinct_view& operator=(distinct_view&& other) {
+        base_ = std::move(other.base_);
+        key_  = std::move(other.key_);
+        seen_ = {};
+        return *this;
+    }
+
+    auto begin() -> iterator {
+        seen_.clear();
+        return iterator{this, std::ranges::begin(base_)};
+    }
+
+    auto end() const -> std::default_sentinel_t { return std::default_sentinel; }
+
+private:
+    V base_ = V();
+    detail::assignable_box<KeyProj> key_;
+    detail::flat_set<K> seen_;
+};
+
+template <std::ranges::viewable_range R, class KeyProj>
+auto distinct_by(R&& r, KeyProj key) {
+    return distinct_view<std::views::all_t<R>, KeyProj>(std::views::all(std::forward<R>(r)), std::move(key));
+}
+
+// Eager counterpart of distinct_by: the projected value of the first element
+// seen for each key, in input order.
+template <std::ranges::input_range R, class KeyProj, class ValProj = std::identity>
+auto dedup_by(R&& r, KeyProj key, ValProj value = {}, std::size_t expected_unique = 0) {
+    using Ref = std::ranges::range_reference_t<R>;
+    using K   = std::decay_t<std::invoke_result_t<KeyProj&, Ref>>;
+    using V   = std::decay_t<std::invoke_result_t<ValProj&, Ref>>;
+
+    detail::flat_set<K> seen;
+    detail::try_reserve(seen, detail::size_hint(r, expected_unique));
+    std::vector<V> out;
+
+    auto key_proj = std::move(key);
+    auto val_proj = std::move(value);
+    for (auto&& x : r) {
+        if (seen.insert(key_proj(x))) out.push_back(val_proj(x));
+    }
+    return out;
+}
+
+// ---- strategy selection ------------------------------------------------
+
+enum class engine { hash, sort, dense };
+
+struct strategy_report {
+    engine chosen          = engine::hash;
+    bool forced            = false;
+    std::size_t size       = 0;  // elements in the input, 0 when unsized
+    std::size_t sampled    = 0;  // prefix elements inspected
+    std::size_t sample_distinct = 0;
+    bool sample_sorted     = false;
+    std::size_t key_span   = 0;  // max - min + 1 over all keys; integral keys, only when dense is considered
+};
+
+// Chooses the engine behind count_by / accumulate_by / group_by when passed
+// as their first argument. `force` overrides the choice; `on_select` sees
+// every decision.
+struct strategy_policy {
+    std::optional<engine> force{};
+    std::size_t sample_size = 1024;
+    std::function<void(strategy_report const&)> on_select{};
+};
+
+namespace strategy {
+
+inline strategy_policy const automatic{};
+inline strategy_policy const hash{engine::hash};
+inline strategy_policy const sort{engine::sort};
+inline strategy_policy const dense{engine::dense};
+
+} // namespace strategy
+
+namespace detail {
+
+inline constexpr std::size_t max_dense_span = std::size_t{1} << 24;
+
+inline auto dense_span_ok(std::size_t span, std::size_t n) -> bool {
+    return span && span <= max_dense_span && span <= std::max<std::size_t>(2 * n, 4096);
+}
+
+// Inspects the input and fills in the report. A forced engine skips the
+// prefix sample; only the dense engine pays for a full min/max pass over
+// integral keys (minimum handed back through key_min), and automatic selection
+// runs it only when the prefix sample already shows a small key span.
+// Single-pass ranges always use the hash engine.
+template <class R, class KeyProj, class K>
+auto select_engine(strategy_policy const& policy, R& r, KeyProj& key, std::optional<K>& key_min) -> strategy_report {
+    strategy_report report;
+    if constexpr (std::ranges::sized_range<R>) report.size = static_cast<std::size_t>(std::ranges::size(r));
+
+    if constexpr (std::ranges::forward_range<R>) {
+        [[maybe_unused]] std::size_t sample_span = 0;
+        if constexpr (std::totally_ordered<K>) {
+            if (!policy.force) {
+                flat_set<K> distinct;
+                std::optional<K> prev;
+                std::optional<K> lo;
+                std::optional<K> hi;
+                report.sample_sorted = true;
+                for (auto&& x : r) {
+                    if (report.sampled == policy.sample_size) break;
+                    K k = key(x);
+                    if constexpr (radix_sortable<K>) {
+                        if (!lo || k < *lo) lo = k;
+                        if (!hi || *hi < k) hi = k;
+                    }
+                    if (prev && k < *prev) report.sample_sorted = false;
+                    distinct.insert(k);
+                    prev = std::move(k);
+                    ++report.sampled;
+                }
+                report.sample_distinct = distinct.size();
+                if constexpr (radix_sortable<K>) {
+                    if (lo) {
+                        auto width  = static_cast<std::uint64_t>(radix_key(*hi) - radix_key(*lo));
+                        sample_span = width < max_dense_span ? static_cast<std::size_t>(width + 1) : max_dense_span + 1;
+                    }
+                }
+            }
+        }
+        if constexpr (radix_sortable<K>) {
+            bool scan = policy.force ? *policy.force == engine::dense
+                                     : dense_span_ok(sample_span, std::max(report.size, report.sampled));
+            auto first = std::ranges::begin(r);
+            if (scan && first != std::ranges::end(r)) {
+                auto lo = static_cast<K>(key(*first));
+                auto hi = lo;
+                std::size_t n = 0;
+                for (auto&& x : r) {
+                    auto k = static_cast<K>(key(x));
+                    lo = std::min(lo, k);
+                    hi = std::max(hi, k);
+                    ++n;
+                }
+                report.size = n;
+                key_min = lo;
+                auto width = static_cast<std::uint64_t>(radix_key(hi) - radix_key(lo));
+                report.key_span = width < max_dense_span ? static_cast<std::size_t>(width + 1) : max_dense_span + 1;
+            }
+        }
+    }
+
+    if (policy.force) {
+        report.chosen = *policy.force;
+        report.forced = true;
+    } else if (radix_sortable<K> && dense_span_ok(report.key_span, report.size)) {
+        report.chosen = engine::dense;
+    } else if (report.sampled > 1 && report.sample_sorted && report.sample_distinct < report.sampled) {
+        report.chosen = engine::sort;
+    } else {
+        report.chosen = engine::hash;
+    }
+
+    // Engines the key type cannot support degrade to hashing.
+    if (report.chosen == engine::dense && !(radix_sortable<K> && std::ranges::forward_range<R> && report.key_span &&
+                                            report.key_span <= max_dense_span)) {
+        report.chosen = engine::hash;
+    }
+    if (report.chosen == engine::sort && !std::totally_ordered<K>) report.chosen = engine::hash;
+
+    if (policy.on_select) policy.on_select(report);
+    return report;
+}
+
+template <class K>
+auto dense_slot(K k, K lo) -> std::size_t {
+    return static_cast<std::size_t>(radix_key(k) - radix_key(lo));
+}
+
+template <class K>
+auto dense_key(std::size_t slot, K lo) -> K {
+    return static_cast<K>(static_cast<std::make_unsigned_t<K>>(lo) + static_cast<std::make_unsigned_t<K>>(slot));
+}
+
+// Sort engine input: (key, value) pairs in key order. Already sorted input is
+// detected and left alone; otherwise a stable sort keeps per-key input order.
+template <class K, class V>
+void sort_by_key_stable(std::vector<std::pair<K, V>>& pairs) {
+    auto by_key = [](auto const& a, auto const& b) { return a.first < b.first; };
+    if (!std::ranges::is_sorted(pairs, by_key)) std::ranges::stable_sort(pairs, by_key);
+}
+
+} // namespace detail
+
+template <std::ranges::input_range R, class KeyProj>
+auto count_by(strategy_policy const& policy, R&& r, KeyProj key) {
+    using K = std::decay_t<std::invoke_result_t<KeyProj&, std::ranges::range_reference_t<R>>>;
+    std::optional<K> key_min;
+    auto report = detail::select_engine(policy, r, key, key_min);
+
+    if constexpr (detail::radix_sortable<K> && std::ranges::forward_range<R>) {
+        if (report.chosen == engine::dense) {
+            std::unordered_map<K, std::size_t> out;
+            if (!report.size) return out;
+            auto lo = *key_min;
+            std::vector<std::size_t> counts(report.key_span);
+            for (auto&& x : r) ++counts[detail::dense_slot(static_cast<K>(key(x)), lo)];
+            for (std::size_t i = 0; i < counts.size(); ++i) {
+                if (counts[i]) out.emplace(detail::dense_key(i, lo), counts[i]);
+            }
+            return out;
+        }
+    }
+    if constexpr (std::totally_ordered<K>) {
+        if (report.chosen == engine::sort) {
+            std::vector<K> keys;
+            if (report.size) keys.reserve(report.size);
+            for (auto&& x : r) keys.push_back(key(x));
+            if (!std::ranges::is_sorted(keys)) std::ranges::sort(keys);
+            std::unordered_map<K, std::size_t> out;
+            for (std::size_t i = 0; i < keys.size();) {
+                auto j = i + 1;
+                while (j < keys.size() && !(keys[i] < keys[j])) ++j;
+                out.emplace(std::move(keys[i]), j - i);
+                i = j;
+            }
+            return out;
+        }
+    }
+    return count_by(std::forward<R>(r), std::move(key), report.size);
+}
+
+template <std::ranges::input_range R, class KeyProj, class ValProj>
+auto accumulate_by(strategy_policy const& policy, R&& r, KeyProj key, ValProj value) {
+    using Ref = std::ranges::range_reference_t<R>;
+    using K   = std::decay_t<std::invoke_result_t<KeyProj&, Ref>>;
+    using V   = std::decay_t<std::invoke_result_t<ValProj&, Ref>>;
+    std::optional<K> key_min;
+    auto report = detail::select_engine(policy, r, key, key_min);
+
+    if constexpr (detail::radix_sortable<K> && std::ranges::forward_range<R>) {
+        if (report.chosen == engine::dense) {
+            std::unordered_map<K, V> out;
+            if (!report.size) return out;
+            auto lo = *key_min;
+            std::vector<V> sums(report.key_span);
+            std::vector<bool> seen(report.key_span);
+            for (auto&& x : r) {
+                auto slot = detail::dense_slot(static_cast<K>(key(x)), lo);
+                sums[slot] += value(x);
+                seen[slot] = true;
+            }
+            for (std::size_t i = 0; i < sums.size(); ++i) {
+                if (seen[i]) out.emplace(detail::dense_key(i, lo), std::move(sums[i]));
+            }
+            return out;
+        }
+    }
+    if constexpr (std::totally_ordered<K>) {
+        if (report.chosen == engine::sort) {
+            std::vector<std::pair<K, V>> pairs;
+            if (report.size) pairs.reserve(report.size);
+            for (auto&& x : r) {
+                auto key_value = key(x);
+                pairs.emplace_back(std::move(key_value), value(x));
+            }
+            detail::sort_by_key_stable(pairs);
+            std::unordered_map<K, V> out;
+            for (std::size_t i = 0; i < pairs.size();) {
+                V sum{};
+                auto j = i;
+                for (; j < pairs.size() && !(pairs[i].first < pairs[j].first); ++j) sum += pairs[j].second;
+                out.emplace(std::move(pairs[i].first), std::move(sum));
+                i = j;
+            }
+            return out;
+        }
+    }
+    return accumulate_by(std::forward<R>(r), std::move(key), std::move(value), report.size);
+}
+
+template <std::ranges::input_range R, class KeyProj, class ValProj = std::identity>
+auto group_by(strategy_policy const& policy, R&& r, KeyProj key, ValProj value = {}) {
+    using Ref = std::ranges::range_reference_t<R>;
+    using K   = std::decay_t<std::invoke_result_t<KeyProj&, Ref>>;
+    using V   = std::decay_t<std::invoke_result_t<ValProj&, Ref>>;
+    std::optional<K> key_min;
+    auto report = detail::select_engine(policy, r, key, key_min);
+
+    if constexpr (detail::radix_sortable<K> && std::ranges::forward_range<R>) {
+        if (report.chosen == engine::dense) {
+            std::unordered_map<K, std::vector<V>> out;
+            if (!report.size) return out;
+            auto lo = *key_min;
+            std::vector<std::size_t> counts(report.key_span);
+            for (auto&& x : r) ++counts[detail::dense_slot(static_cast<K>(key(x)), lo)];
+            std::vector<std::vector<V>> buckets(report.key_span);
+            for (std::size_t i = 0; i < counts.size(); ++i) buckets[i].reserve(counts[i]);
+            for (auto&& x : r) buckets[detail::dense_slot(static_cast<K>(key(x)), lo)].push_back(value(x));
+            for (std::size_t i = 0; i < buckets.size(); ++i) {
+                if (counts[i]) out.emplace(detail::dense_key(i, lo), std::move(buckets[i]));
+            }
+            return out;
+        }
+    }
+    if constexpr (std::totally_ordered<K>) {
+        if (report.chosen == engine::sort) {
+            std::vector<std::pair<K, V>> pairs;
+            if (report.size) pairs.reserve(report.size);
+            for (auto&& x : r) {
+                auto key_value = key(x);
+                pairs.emplace_back(std::move(key_value), value(x));
+            }
+            detail::sort_by_key_stable(pairs);
+            std::unordered_map<K, std::vector<V>> out;
+            for (std::size_t i = 0; i < pairs.size();) {
+                auto j = i;
+                while (j < pairs.size() && !(pairs[i].first < pairs[j].first)) ++j;
+                std::vector<V> bucket;
+                bucket.reserve(j - i);
+                for (auto k = i; k < j; ++k) bucket.push_back(std::move(pairs[k].second));
+                out.emplace(std::move(pairs[i].first), std::move(bucket));
+                i = j;
+            }
+            return out;
+        }
+    }
+    return group_by(std::forward<R>(r), std::move(key), std::move(value), report.size);
+}
+
+// ---- columnar aggregation ----------------------------------------------
+
+template <class K, class V>
+struct column_extrema {
+    std::vector<K> keys;
+    std::vector<V> min;
+    std::vector<V> max;
+};
+
+namespace detail {
+
+inline constexpr std::size_t column_block = 256;
+
+// Maps a key column to dense group ids (first-seen order), one block at a
+// time. Runs of equal keys reuse the previous id without a hash lookup, so
+// sorted or clustered columns rarely touch the table. Ids are 32-bit; more
+// distinct keys throw std::length_error.
+template <class K>
+struct column_grouper {
+    std::unordered_map<K, std::uint32_t> ids;
+    std::vector<K> keys;
+    std::optional<K> last_key;
+    std::uint32_t last_id = 0;
+
+    auto resolve_one(K const& key) -> std::uint32_t {
+        if (!last_key || !(key == *last_key)) {
+            if (keys.size() >= std::numeric_limits<std::uint32_t>::max() && !ids.contains(key)) {
+                throw std::length_error("column_grouper: too many distinct keys");
+            }
+            auto [it, inserted] = ids.try_emplace(key, static_cast<std::uint32_t>(keys.size()));
+            if (inserted) keys.push_back(key);
+            last_key = key;
+            last_id  = it->second;
+        }
+        return last_id;
+    }
+
+    void resolve(std::span<K const> block, std::uint32_t* out) {
+        for (std::size_t i = 0; i < block.size(); ++i) out[i] = resolve_one(block[i]);
+    }
+};
+
+template <class Keys, class Values>
+void check_columns(Keys const& keys, Values const& values) {
+    if (std::ranges::size(keys) != std::ranges::size(values)) {
+        throw std::invalid_argument("bykey: key and value columns differ in length");
+    }
+}
+
+template <class Column>
+auto as_span(Column const& c) {
+    return std::span<std::ranges::range_value_t<Column> const>(std::ranges::data(c), std::ranges::size(c));
+}
+
+} // namespace detail
+
+template <std::ranges::contiguous_range Keys>
+auto count_by_column(Keys const& key_column) {
+    using K = std::ranges::range_value_t<Keys>;
+    auto keys = detail::as_span(key_column);
+    detail::column_grouper<K> grouper;
+    std::vector<std::size_t> counts;
+    std::uint32_t ids[detail::column_block];
+
+    for (std::size_t base = 0; base < keys.size(); base += detail::column_block) {
+        auto n = std::min(detail::column_block, keys.size() - base);
+        grouper.resolve(keys.subspan(base, n), ids);
+        counts.resize(grouper.keys.size());
+        for (std::size_t i = 0; i < n; ++i) ++counts[ids[i]];
+    }
+    return column_result<K, std::size_t>{std::move(grouper.keys), std::move(counts)};
+}
+
+template <std::ranges::contiguous_range Keys, std::ranges::contiguous_range Values>
+auto accumulate_by_columns(Keys const& key_column, Values const& value_column) {
+    using K = std::ranges::range_value_t<Keys>;
+    using V = std::ranges::range_value_t<Values>;
+    detail::check_columns(key_column, value_column);
+    auto keys   = detail::as_span(key_column);
+    auto values = detail::as_span(value_column);
+    detail::column_grouper<K> grouper;
+    std::vector<V> sums;
+    std::uint32_t ids[detail::column_block];
+
+    for (std::size_t base = 0; base < keys.size(); base += detail::column_block) {
+        auto n = std::min(detail::column_block, keys.size() - base);
+        grouper.resolve(keys.subspan(base, n), ids);
+        sums.resize(grouper.keys.size());
+        V const* vals = values.data() + base;
+        for (std::size_t i = 0; i < n; ++i) sums[ids[i]] += vals[i];
+    }
+    return column_result<K, V>{std::move(grouper.keys), std::move(sums)};
+}
+
+template <std::ranges::contiguous_range Keys, std::ranges::contiguous_range Values>
+auto extrema_by_columns(Keys const& key_column, Values const& value_column) {
+    using K = std::ranges::range_value_t<Keys>;
+    using V = std::ranges::range_value_t<Values>;
+    detail::check_columns(key_column, value_column);
+    auto keys   = detail::as_span(key_column);
+    auto values = detail::as_span(value_column);
+    detail::column_grouper<K> grouper;
+    column_extrema<K, V> out;
+    std::uint32_t ids[detail::column_block];
+
+    for (std::size_t base = 0; base < keys.size(); base += detail::column_block) {
+        auto n = std::min(detail::column_block, keys.size() - base);
+        grouper.resolve(keys.subspan(base, n), ids);
+        V const* vals = values.data() + base;
+        for (std::size_t i = 0; i < n; ++i) {
+            if (ids[i] == out.min.size()) { // first sighting seeds both extrema
+                out.min.push_back(vals[i]);
+                out.max.push_back(vals[i]);
+            }
+        }
+        for (std::size_t i = 0; i < n; ++i) {
+            auto id = ids[i];
+            out.min[id] = std::min(out.min[id], vals[i]);
+            out.max[id] = std::max(out.max[id], vals[i]);
+        }
+    }
+    out.keys = std::move(grouper.keys);
+    return out;
+}
+
+// ---- grouping objects --------------------------------------------------
+
+template <std::ranges::view View, class K>
+    requires std::ranges::forward_range<View const>
+class grouping {
+    using row_ref = std::ranges::range_reference_t<View const>;
+
+    template <class ValProj>
+    using value_t = std::decay_t<std::invoke_result_t<ValProj&, row_ref>>;
+
+public:
+    using key_type = K;
+
+    grouping(View rows, std::vector<K> keys, std::vector<std::uint32_t> ids)
+        : rows_(std::move(rows)), keys_(std::move(keys)), ids_(std::move(ids)) {}
+
+    auto keys() const noexcept -> std::vector<K> const& { return keys_; }
+    auto ids() const noexcept -> std::vector<std::uint32_t> const& { return ids_; }
+    auto size() const noexcept -> std::size_t { return keys_.size(); }
+    auto rows() const noexcept -> View const& { return rows_; }
+
+    auto count() const -> std::vector<std::size_t> {
+        std::vector<std::size_t> out(keys_.size());
+        for (auto id : ids_) ++out[id];
+        return out;
+    }
+
+    template <class ValProj = std::identity>
+    auto sum(ValProj value = {}) const {
+        return reduce(detail::sum_traits<value_t<ValProj>>{}, std::move(value));
+    }
+
+    template <class ValProj = std::identity, class Compare = std::ranges::less>
+    auto extrema(ValProj value = {}, Compare comp = {}) const {
+        using V = value_t<ValProj>;
+        std::vector<extrema_result<V>> out;
+        out.reserve(keys_.size());
+        auto id = ids_.begin();
+        for (auto&& x : rows_) {
+            V v = value(x);
+            auto g = *id++;
+            if (g == out.size()) { // ids are assigned in first-seen order
+                out.push_back({v, v});
+                continue;
+            }
+            auto& e = out[g];
+            if (comp(v, e.min)) e.min = v;
+            if (comp(e.max, v)) e.max = std::move(v);
+        }
+        return out;
+    }
+
+    template <class ValProj = std::identity>
+    auto group(ValProj value = {}) const {
+        std::vector<std::vector<value_t<ValProj>>> out(keys_.size());
+        auto sizes = count();
+        for (std::size_t g = 0; g < out.size(); ++g) out[g].reserve(sizes[g]);
+        auto id = ids_.begin();
+        for (auto&& x : rows_) out[*id++].push_back(value(x));
+        return out;
+    }
+
+    template <class Traits, class ValProj = std::identity>
+    auto reduce(Traits traits, ValProj value = {}) const {
+        using Acc = std::decay_t<decltype(traits.identity())>;
+        std::vector<Acc> accs(keys_.size(), traits.identity());
+        auto id = ids_.begin();
+        for (auto&& x : rows_) traits.combine(accs[*id++], value(x));
+
+        if constexpr (detail::has_finalize<Traits, Acc>) {
+            using Result = std::decay_t<decltype(traits.finalize(std::declval<Acc const&>()))>;
+            std::vector<Result> out;
+            out.reserve(accs.size());
+            for (auto const& acc : accs) out.push_back(traits.finalize(acc));
+            return out;
+        } else {
+            return accs;
+        }
+    }
+
+private:
+    View rows_;
+    std::vector<K> keys_;
+    std::vector<std::uint32_t> ids_;
+};
+
+template <std::ranges::viewable_range R, class KeyProj>
+    requires std::ranges::forward_range<std::views::all_t<R> const>
+auto make_grouping(R&& r, KeyProj key) {
+    using View = std::views::all_t<R>;
+    using K    = std::decay_t<std::invoke_result_t<KeyProj&, std::ranges::range_reference_t<View const>>>;
+
+    View rows = std::views::all(std::forward<R>(r));
+    detail::column_grouper<K> grouper;
+    std::vector<std::uint32_t> ids;
+    if constexpr (std::ranges::sized_range<View const>) ids.reserve(std::ranges::size(std::as_const(rows)));
+
+    for (auto&& x : std::as_const(rows)) ids.push_back(grouper.resolve_one(key(x)));
+    return grouping<View, K>(std::move(rows), std::move(grouper.keys), std::move(ids));
+}
+
+// ---- key encoding ------------------------------------------------------
+
+namespace detail {
+
+template <class K>
+struct encoding_storage {
+    using view_type = K;
+
+    auto store(K const& key) -> K { return key; }
+};
+
+// Distinct string keys are copied once into fixed-size blocks, so the views
+// handed out stay valid while the dictionary grows and when it is moved.
+template <class Char, class CharTraits, class Alloc>
+struct encoding_storage<std::basic_string<Char, CharTraits, Alloc>> {
+    using view_type = std::basic_string_view<Char, CharTraits>;
+
+    static constexpr std::size_t block_size = 64 * 1024 / sizeof(Char);
+
+    std::vector<std::unique_ptr<Char[]>> blocks;
+    Char* cursor = nullptr;
+    std::size_t left = 0;
+
+    auto store(view_type key) -> view_type {
+        if (key.size() > left) {
+            if (key.size() > block_size / 4) {
+                auto& block = blocks.emplace_back(std::make_unique_for_overwrite<Char[]>(key.size()));
+                std::ranges::copy(key, block.get());
+                return {block.get(), key.size()};
+            }
+            cursor = blocks.emplace_back(std::make_unique_for_overwrite<Char[]>(block_size)).get();
+            left   = block_size;
+        }
+        std::ranges::copy(key, cursor);
+        view_type out(cursor, key.size());
+        cursor += key.size();
+        left -= key.size();
+        return out;
+    }
+};
+
+} // namespace detail
+
+template <class K, class Hash = std::hash<typename detail::encoding_storage<K>::view_type>>
+class key_encoding {
+public:
+    using key_type = typename detail::encoding_storage<K>::view_type;
+
+    key_encoding() = default;
+    key_encoding(key_encoding const&) = delete;
+    key_encoding(key_encoding&&) noexcept = default;
+    auto operator=(key_encoding const&) -> key_encoding& = delete;
+    auto operator=(key_encoding&&) noexcept -> key_encoding& = default;
+
+    auto append(key_type key) -> std::uint32_t {
+        if (!codes_.empty() && dictionary_[codes_.back()] == key) {
+            codes_.push_back(codes_.back());
+            return codes_.back();
+        }
+        auto it = index_.find(key);
+        if (it == index_.end()) {
+            if (dictionary_.size() >= std::numeric_limits<std::uint32_t>::max()) {
+                throw std::length_error("key_encoding: too many distinct keys");
+            }
+            auto stored = storage_.store(key);
+            it = index_.emplace(stored, static_cast<std::uint32_t>(dictionary_.size())).first;
+            dictionary_.push_back(stored);
+        }
+        codes_.push_back(it->second);
+        return it->second;
+    }
+
+    void reserve(std::size_t rows, std::size_t distinct = 0) {
+        codes_.reserve(rows);
+        if (distinct) {
+            dictionary_.reserve(distinct);
+            index_.reserve(distinct);
+        }
+    }
+
+    auto keys() const noexcept -> std::vector<key_type> const& { return dictionary_; }
+    auto codes() const noexcept -> std::vector<std::uint32_t> const& { return codes_; }
+    auto size() const noexcept -> std::size_t { return dictionary_.size(); }
+    auto rows() const noexcept -> std::size_t { return codes_.size(); }
+    auto operator[](std::size_t row) const -> key_type { return dictionary_[codes_[row]]; }
+
+    auto code_of(key_type key) const -> std::optional<std::uint32_t> {
+        auto it = index_.find(key);
+        if (it == index_.end()) return std::nullopt;
+        return it->second;
+    }
+
+private:
+    detail::encoding_storage<K> storage_;
+    std::vector<key_type> dictionary_;
+    std::vector<std::uint32_t> codes_;
+    std::unordered_map<key_type, std::uint32_t, Hash> index_;
+};
+
+template <std::ranges::input_range R, class KeyProj>
+auto encode_keys(R&& r, KeyProj key, std::size_t expected_unique = 0) {
+    using Ref = std::ranges::range_reference_t<R>;
+    using K   = std::decay_t<std::invoke_result_t<KeyProj&, Ref>>;
+
+    key_encoding<K> enc;
+    if constexpr (std::ranges::sized_range<R>) {
+        enc.reserve(std::ranges::size(r), expected_unique);
+    } else {
+        enc.reserve(0, expected_unique);
+    }
+    for (auto&& x : r) enc.append(key(x));
+    return enc;
+}
+
+template <class K, class Hash>
+auto count_by(key_encoding<K, Hash> const& enc) {
+    std::vector<std::size_t> counts(enc.size());
+    for (auto code : enc.codes()) ++counts[code];
+    return column_result<typename key_encoding<K, Hash>::key_type, std::size_t>{enc.keys(), std::move(counts)};
+}
+
+template <class K, class Hash, std::ranges::sized_range Values>
+auto accumulate_by(key_encoding<K, Hash> const& enc, Values const& values) {
+    using V = std::decay_t<std::ranges::range_reference_t<Values const>>;
+    detail::check_columns(enc.codes(), values);
+    std::vector<V> sums(enc.size());
+    auto code = enc.codes().begin();
+    for (auto&& v : values) sums[*code++] += v;
+    return column_result<typename key_encoding<K, Hash>::key_type, V>{enc.keys(), std::move(sums)};
+}
+
+template <std::ranges::viewable_range R, class K, class Hash>
+    requires std::ranges::forward_range<std::views::all_t<R> const>
+auto make_grouping(R&& r, key_encoding<K, Hash> const& enc) {
+    using View = std::views::all_t<R>;
+    View rows = std::views::all(std::forward<R>(r));
+    if constexpr (std::ranges::sized_range<View const>) {
+        detail::check_columns(enc.codes(), std::as_const(rows));
+    }
+    return grouping<View, typename key_encoding<K, Hash>::key_type>(std::move(rows), enc.keys(), enc.codes());
+}
+
+// ---- nested grouping ---------------------------------------------------
+
+namespace detail {
+
+struct tuple_hash {
+    template <class... Ts>
+    auto operator()(std::tuple<Ts...> const& t) const -> std::size_t {
+        return std::apply([](auto const&... xs) {
+            std::size_t h = 0;
+            ((h = mix_hash(h + std::hash<std::decay_t<decltype(xs)>>{}(xs))), ...);
+            return h;
+        }, t);
+    }
+};
+
+template <std::size_t N, class Tuple>
+auto tuple_prefix(Tuple const& t) {
+    return [&]<std::size_t... I>(std::index_sequence<I...>) {
+        return std::tie(std::get<I>(t)...);
+    }(std::make_index_sequence<N>{});
+}
+
+} // namespace detail
+
+// Leaves are the distinct key tuples in sorted order and values are stored
+// contiguously per leaf, so every key prefix owns one contiguous slice.
+template <class Key, class V>
+class level_grouping {
+public:
+    using key_type   = Key;
+    using value_type = V;
+
+    static constexpr std::size_t depth = std::tuple_size_v<Key>;
+
+    level_grouping(std::vector<Key> leaves, std::vector<std::uint32_t> const& row_leaf, std::vector<V> rows) {
+        std::vector<std::uint32_t> order(leaves.size());
+        for (std::size_t i = 0; i < order.size(); ++i) order[i] = static_cast<std::uint32_t>(i);
+        std::ranges::sort(order, std::ranges::less{}, [&](std::uint32_t i) -> Key const& { return leaves[i]; });
+
+        std::vector<std::uint32_t> rank(leaves.size());
+        keys_.reserve(leaves.size());
+        for (std::size_t i = 0; i < order.size(); ++i) {
+            rank[order[i]] = static_cast<std::uint32_t>(i);
+            keys_.push_back(std::move(leaves[order[i]]));
+        }
+
+        offsets_.assign(keys_.size() + 1, 0);
+        for (auto leaf : row_leaf) ++offsets_[rank[leaf] + 1];
+        for (std::size_t i = 1; i < offsets_.size(); ++i) offsets_[i] += offsets_[i - 1];
+
+        std::vector<std::size_t> cursor(offsets_.begin(), offsets_.end() - 1);
+        std::vector<std::size_t> slot(rows.size());
+        for (std::size_t i = 0; i < rows.size(); ++i) slot[cursor[rank[row_leaf[i]]]++] = i;
+        values_.reserve(rows.size());
+        for (auto i : slot) values_.push_back(std::move(rows[i]));
+
+        for (auto& b : boundaries_) b.push_back(0);
+        for (std::size_t i = 1; i < keys_.size(); ++i) {
+            auto first_diff = mismatch_level(keys_[i - 1], keys_[i]);
+            for (auto l = first_diff; l < depth; ++l) boundaries_[l].push_back(i);
+        }
+        for (auto& b : boundaries_) {
+            if (keys_.empty()) b.clear();
+            b.push_back(keys_.size());
+        }
+    }
+
+    auto size() const noexcept -> std::size_t { return keys_.size(); }
+    auto keys() const noexcept -> std::vector<Key> const& { return keys_; }
+    auto offsets() const noexcept -> std::vector<std::size_t> const& { return offsets_; }
+
+    // Leaf indices where the prefix of length level + 1 changes, followed by size().
+    auto boundaries(std::size_t level) const -> std::vector<std::size_t> const& { return boundaries_.at(level); }
+
+    template <class... Prefix>
+        requires (sizeof...(Prefix) <= depth)
+    auto leaf_range(Prefix const&... prefix) const -> std::pair<std::size_t, std::size_t> {
+        constexpr auto N = sizeof...(Prefix);
+        if constexpr (N == 0) {
+            return {0, keys_.size()};
+        } else {
+            auto probe = make_probe(std::make_index_sequence<N>{}, prefix...);
+            auto [first, last] = std::ranges::equal_range(keys_, detail::tuple_prefix<N>(probe), std::ranges::less{},
+                                                          [](Key const& k) { return detail::tuple_prefix<N>(k); });
+            return {static_cast<std::size_t>(first - keys_.begin()), static_cast<std::size_t>(last - keys_.begin())};
+        }
+    }
+
+    template <class... Prefix>
+        requires (sizeof...(Prefix) <= depth)
+    auto values(Prefix const&... prefix) const -> std::span<V const> {
+        auto [first, last] = leaf_range(prefix...);
+        return std::span<V const>(values_).subspan(offsets_[first], offsets_[last] - offsets_[first]);
+    }
+
+    template <class... Prefix>
+        requires (sizeof...(Prefix) <= depth)
+    auto count(Prefix const&... prefix) const -> std::size_t { return values(prefix...).size(); }
+
+    template <class... Prefix>
+        requires (sizeof...(Prefix) < depth)
+    auto children(Prefix const&... prefix) const {
+        constexpr auto N = sizeof...(Prefix);
+        auto [first, last] = leaf_range(prefix...);
+        auto const& starts = boundaries_[N];
+        std::vector<std::tuple_element_t<N, Key>> out;
+        for (auto it = std::ranges::lower_bound(starts, first); it != starts.end() && *it < last; ++it) {
+            out.push_back(std::get<N>(keys_[*it]));
+        }
+        return out;
+    }
+
+private:
+    template <std::size_t... I, class... Prefix>
+    static auto make_probe(std::index_sequence<I...>, Prefix const&... prefix) {
+        return std::tuple<std::tuple_element_t<I, Key>...>(prefix...);
+    }
+
+    static auto mismatch_level(Key const& a, Key const& b) -> std::size_t {
+        std::size_t level = depth;
+        [&]<std::size_t... I>(std::index_sequence<I...>) {
+            ((level == depth && !(std::get<I>(a) == std::get<I>(b)) ? void(level = I) : void()), ...);
+        }(std::make_index_sequence<depth>{});
+        return level;
+    }
+
+    std::vector<Key> keys_;
+    std::vector<std::size_t> offsets_;
+    std::vector<V> values_;
+    std::array<std::vector<std::size_t>, depth> boundaries_;
+};
+
+template <std::ranges::input_range R, class... KeyProjs>
+    requires (sizeof...(KeyProjs) > 0)
+auto group_by_levels(R&& r, KeyProjs... keys) {
+    using Ref = std::ranges::range_reference_t<R>;
+    using Key = std::tuple<std::decay_t<std::invoke_result_t<KeyProjs&, Ref>>...>;
+    using V   = std::ranges::range_value_t<R>;
+
+    std::unordered_map<Key, std::uint32_t, detail::tuple_hash> ids;
+    std::vector<Key> leaves;
+    std::vector<std::uint32_t> row_leaf;
+    std::vector<V> rows;
+    if constexpr (std::ranges::sized_range<R>) {
+        row_leaf.reserve(std::ranges::size(r));
+        rows.reserve(std::ranges::size(r));
+    }
+
+    for (auto&& x : r) {
+        auto [it, inserted] = ids.try_emplace(Key{keys(x)...}, static_cast<std::uint32_t>(leaves.size()));
+        if (inserted) leaves.push_back(it->first);
+        row_leaf.push_back(it->second);
+        rows.emplace_back(std::forward<decltype(x)>(x));
+    }
+    return level_grouping<Key, V>(std::move(leaves), row_leaf, std::move(rows));
+}
+
+// ---- rollup and cube ---------------------------------------------------
+
+namespace detail {
+
+template <class Tuple>
+struct optional_tuple;
+
+template <class... Ks>
+struct optional_tuple<std::tuple<Ks...>> {
+    using type = std::tuple<std::optional<Ks>...>;
+};
+
+template <class OptKey>
+auto mask_key(OptKey const& key, unsigned mask) -> OptKey {
+    return [&]<std::size_t... I>(std::index_sequence<I...>) {
+        return OptKey{((mask >> I) & 1u ? std::get<I>(key) : std::nullopt)...};
+    }(std::make_index_sequence<std::tuple_size_v<OptKey>>{});
+}
+
+// Aggregates once per distinct full key, then derives each coarser grouping
+// set by merging the states of its smallest already-computed parent set.
+template <class R, class KeyProj, class ValProj, class Traits>
+auto grouping_sets(R&& r, KeyProj key, ValProj value, Traits traits, std::vector<unsigned> const& masks) {
+    using Ref    = std::ranges::range_reference_t<R>;
+    using Key    = std::decay_t<std::invoke_result_t<KeyProj&, Ref>>;
+    using OptKey = typename optional_tuple<Key>::type;
+    using Acc    = std::decay_t<decltype(traits.identity())>;
+    using Table  = std::unordered_map<OptKey, Acc, tuple_hash>;
+    static_assert(has_merge<Traits, Acc>, "rollup_by/cube_by need traits with merge(acc&, acc&&)");
+
+    constexpr auto dims = std::tuple_size_v<Key>;
+    static_assert(dims < 16, "too many grouping dimensions");
+    constexpr unsigned full = (1u << dims) - 1;
+
+    std::unordered_map<Key, Acc, tuple_hash> finest;
+    try_reserve(finest, size_hint(r, 0));
+    for (auto&& x : r) {
+        auto [it, inserted] = finest.try_emplace(key(x), traits.identity());
+        traits.combine(it->second, value(x));
+    }
+
+    std::vector<std::optional<Table>> sets(full + 1);
+    auto& base = sets[full].emplace();
+    base.reserve(finest.size());
+    while (!finest.empty()) {
+        auto node = finest.extract(finest.begin());
+        base.emplace(std::apply([](auto&... parts) { return OptKey{std::move(parts)...}; }, node.key()),
+                     std::move(node.mapped()));
+    }
+
+    auto ordered = masks;
+    std::ranges::sort(ordered, std::ranges::greater{}, [](unsigned m) { return std::popcount(m); });
+    for (auto mask : ordered) {
+        if (sets[mask]) continue;
+        Table const* parent = nullptr;
+        for (std::size_t d = 0; d < dims; ++d) {
+            auto candidate = mask | (1u << d);
+            if (candidate != mask && sets[candidate] && (!parent || sets[candidate]->size() < parent->size())) {
+                parent = &*sets[candidate];
+            }
+        }
+        auto& table = sets[mask].emplace();
+        for (auto const& [k, acc] : *parent) {
+            auto [it, inserted] = table.try_emplace(mask_key(k, mask), acc);
+            if (!inserted) traits.merge(it->second, Acc(acc));
+        }
+    }
+
+    Table out;
+    for (auto mask : masks) out.merge(*sets[mask]);
+    return finalize_map(traits, std::move(out));
+}
+
+template <std::size_t Dims>
+auto rollup_masks() -> std::vector<unsigned> {
+    std::vector<unsigned> masks;
+    for (std::size_t len = Dims + 1; len-- > 0;) masks.push_back((1u << len) - 1);
+    return masks;
+}
+
+template <std::size_t Dims>
+auto cube_masks() -> std::vector<unsigned> {
+    std::vector<unsigned> masks;
+    for (unsigned m = 1u << Dims; m-- > 0;) masks.push_back(m);
+    return masks;
+}
+
+template <class R, class KeyProj>
+constexpr std::size_t key_dims = std::tuple_size_v<std::decay_t<std::invoke_result_t<KeyProj&, std::ranges::range_reference_t<R>>>>;
+
+} // namespace detail
+
+template <std::ranges::input_range R, class KeyProj, class ValProj, class Traits>
+auto rollup_by(R&& r, KeyProj key, ValProj value, Traits traits) {
+    return detail::grouping_sets(std::forward<R>(r), std::move(key), std::move(value), std::move(traits),
+                                 detail::rollup_masks<detail::key_dims<R, KeyProj>>());
+}
+
+template <std::ranges::input_range R, class KeyProj, class ValProj>
+auto rollup_by(R&& r, KeyProj key, ValProj value) {
+    using V = std::decay_t<std::invoke_result_t<ValProj&, std::ranges::range_reference_t<R>>>;
+    return rollup_by(std::forward<R>(r), std::move(key), std::move(value), detail::sum_traits<V>{});
+}
+
+template <std::ranges::input_range R, class KeyProj, class ValProj, class Traits>
+auto cube_by(R&& r, KeyProj key, ValProj value, Traits traits) {
+    return detail::grouping_sets(std::forward<R>(r), std::move(key), std::move(value), std::move(traits),
+                                 detail::cube_masks<detail::key_dims<R, KeyProj>>());
+}
+
+template <std::ranges::input_range R, class KeyProj, class ValProj>
+auto cube_by(R&& r, KeyProj key, ValProj value) {
+    using V = std::decay_t<std::invoke_result_t<ValProj&, std::ranges::range_reference_t<R>>>;
+    return cube_by(std::forward<R>(r), std::move(key), std::move(value), detail::sum_traits<V>{});
+}
+
+// ---- window functions --------------------------------------------------
+
+template <std::ranges::input_range R, class KeyProj, class ValProj, class BinaryOp = std::plus<>>
+auto scan_by(R&& r, KeyProj key, ValProj value, BinaryOp op = {}) {
+    using Ref = std::ranges::range_reference_t<R>;
+    using K   = std::decay_t<std::invoke_result_t<KeyProj&, Ref>>;
+    using V   = std::decay_t<std::invoke_result_t<ValProj&, Ref>>;
+
+    detail::column_grouper<K> grouper;
+    std::vector<V> state;
+    std::vector<V> out;
+    if constexpr (std::ranges::sized_range<R>) out.reserve(std::ranges::size(r));
+
+    for (auto&& x : r) {
+        auto id = grouper.resolve_one(key(x));
+        if (id == state.size()) {
+            state.push_back(value(x));
+        } else {
+            state[id] = op(std::move(state[id]), value(x));
+        }
+        out.push_back(state[id]);
+    }
+    return out;
+}
+
+template <std::ranges::input_range R, class KeyProj>
+auto row_number_by(R&& r, KeyProj key) {
+    using K = std::decay_t<std::invoke_result_t<KeyProj&, std::ranges::range_reference_t<R>>>;
+
+    detail::column_grouper<K> grouper;
+    std::vector<std::size_t> seen;
+    std::vector<std::size_t> out;
+    if constexpr (std::ranges::sized_range<R>) out.reserve(std::ranges::size(r));
+
+    for (auto&& x : r) {
+        auto id = grouper.resolve_one(key(x));
+        if (id == seen.size()) seen.push_back(0);
+        out.push_back(++seen[id]);
+    }
+    return out;
+}
+
+// Each key keeps a ring of its last `offset` values, stored back to back for all keys.
+template <std::ranges::input_range R, class KeyProj, class ValProj>
+auto lag_by(R&& r, KeyProj key, ValProj value, std::size_t offset = 1) {
+    using Ref = std::ranges::range_reference_t<R>;
+    using K   = std::decay_t<std::invoke_result_t<KeyProj&, Ref>>;
+    using V   = std::decay_t<std::invoke_result_t<ValProj&, Ref>>;
+
+    detail::column_grouper<K> grouper;
+    std::vector<std::optional<V>> ring;
+    std::vector<std::size_t> seen;
+    std::vector<std::optional<V>> out;
+    if constexpr (std::ranges::sized_range<R>) out.reserve(std::ranges::size(r));
+
+    for (auto&& x : r) {
+        auto id = grouper.resolve_one(key(x));
+        if (offset == 0) {
+            out.emplace_back(value(x));
+            continue;
+        }
+        if (id == seen.size()) {
+            seen.push_back(0);
+            ring.resize(ring.size() + offset);
+        }
+        auto& slot = ring[id * offset + seen[id]++ % offset];
+        out.push_back(std::exchange(slot, value(x)));
+    }
+    return out;
+}
+
+// Each key keeps a ring of its last `offset` row positions; a new row fills in
+// the lead of the row `offset` places earlier.
+template <std::ranges::input_range R, class KeyProj, class ValProj>
+auto lead_by(R&& r, KeyProj key, ValProj value, std::size_t offset = 1) {
+    using Ref = std::ranges::range_reference_t<R>;
+    using K   = std::decay_t<std::invoke_result_t<KeyProj&, Ref>>;
+    using V   = std::decay_t<std::invoke_result_t<ValProj&, Ref>>;
+
+    detail::column_grouper<K> grouper;
+    std::vector<std::size_t> ring;
+    std::vector<std::size_t> seen;
+    std::vector<std::optional<V>> out;
+    if constexpr (std::ranges::sized_range<R>) out.reserve(std::ranges::size(r));
+
+    for (auto&& x : r) {
+        auto id = grouper.resolve_one(key(x));
+        auto row = out.size();
+        out.emplace_back();
+        if (offset == 0) {
+            out.back().emplace(value(x));
+            continue;
+        }
+        if (id == seen.size()) {
+            seen.push_back(0);
+            ring.resize(ring.size() + offset);
+        }
+        auto n = seen[id]++;
+        auto& slot = ring[id * offset + n % offset];
+        if (n >= offset) out[slot].emplace(value(x));
+        slot = row;
+    }
+    return out;
+}
+
+// ---- bounded per-key values --------------------------------------------
+
+// Keeps the first k values per key in Compare order (the k largest with the
+// default std::ranges::greater). Each key owns k consecutive slots holding a
+// heap whose front is the value that would be evicted next.
+template <class K, class V, class Compare = std::ranges::greater>
+class top_k_accumulator {
+    static_assert(std::default_initializable<V>, "top_k_accumulator stores values in preallocated slots");
+
+public:
+    explicit top_k_accumulator(std::size_t k, Compare comp = {}) : k_(k), comp_(std::move(comp)) {}
+
+    void add(K const& key, V value) {
+        if (!k_) return;
+        auto id = grouper_.resolve_one(key);
+        if (id == sizes_.size()) {
+            sizes_.push_back(0);
+            slots_.resize(slots_.size() + k_);
+        }
+        auto first = slots_.begin() + static_cast<std::ptrdiff_t>(id * k_);
+        auto& n = sizes_[id];
+        if (n < k_) {
+            first[static_cast<std::ptrdiff_t>(n++)] = std::move(value);
+            std::ranges::push_heap(first, first + static_cast<std::ptrdiff_t>(n), comp_);
+        } else if (comp_(value, *first)) {
+            std::ranges::pop_heap(first, first + static_cast<std::ptrdiff_t>(k_), comp_);
+            first[static_cast<std::ptrdiff_t>(k_ - 1)] = std::move(value);
+            std::ranges::push_heap(first, first + static_cast<std::ptrdiff_t>(k_), comp_);
+        }
+    }
+
+    template <std::ranges::input_range R, class KeyProj, class ValProj>
+    void add_range(R&& r, KeyProj key, ValProj value) {
+        for (auto&& x : r) add(key(x), value(x));
+    }
+
+    void merge(top_k_accumulator&& other) {
+        for (std::size_t id = 0; id < other.sizes_.size(); ++id) {
+            auto const& key = other.grouper_.keys[id];
+            for (std::size_t i = 0; i < other.sizes_[id]; ++i) add(key, std::move(other.slots_[id * other.k_ + i]));
+        }
+        other = top_k_accumulator(other.k_, other.comp_);
+    }
+
+    auto k() const noexcept -> std::size_t { return k_; }
+    auto size() const noexcept -> std::size_t { return sizes_.size(); }
+    auto keys() const noexcept -> std::vector<K> const& { return grouper_.keys; }
+
+    // Unordered (heap-ordered) values kept for the key at position `group` of keys().
+    auto values(std::size_t group) const -> std::span<V const> {
+        return std::span<V const>(slots_).subspan(group * k_, sizes_[group]);
+    }
+
+    auto to_map() const -> std::unordered_map<K, std::vector<V>> {
+        std::unordered_map<K, std::vector<V>> out;
+        out.reserve(size());
+        for (std::size_t id = 0; id < size(); ++id) {
+            auto kept = values(id);
+            std::vector<V> sorted(kept.begin(), kept.end());
+            std::ranges::sort(sorted, comp_);
+            out.emplace(grouper_.keys[id], std::move(sorted));
+        }
+        return out;
+    }
+
+private:
+    std::size_t k_;
+    Compare comp_;
+    detail::column_grouper<K> grouper_;
+    std::vector<std::size_t> sizes_;
+    std::vector<V> slots_;
+};
+
+template <std::ranges::input_range R, class KeyProj, class ValProj, class Compare = std::ranges::greater>
+auto top_k_per_key_by(R&& r, KeyProj key, ValProj value, std::size_t k, Compare comp = {}) {
+    using Ref = std::ranges::range_reference_t<R>;
+    using K   = std::decay_t<std::invoke_result_t<KeyProj&, Ref>>;
+    using V   = std::decay_t<std::invoke_result_t<ValProj&, Ref>>;
+
+    top_k_accumulator<K, V, Compare> acc(k, std::move(comp));
+    acc.add_range(std::forward<R>(r), std::move(key), std::move(value));
+    return acc.to_map();
+}
+
+// Uniform reservoir of at most n values per key (Algorithm R), laid out like
+// top_k_accumulator. Merging draws from the two reservoirs in proportion to
+// the rows each has seen, which keeps the merged sample uniform.
+template <class K, class V>
+class reservoir_accumulator {
+    static_assert(std::default_initializable<V>, "reservoir_accumulator stores values in preallocated slots");
+
+public:
+    explicit reservoir_accumulator(std::size_t n, std::uint64_t seed = std::mt19937_64::default_seed)
+        : n_(n), rng_(seed) {}
+
+    void add(K const& key, V value) {
+        auto id = group_of(key);
+        auto t = seen_[id]++;
+        if (t < n_) {
+            slots_[id * n_ + t] = std::move(value);
+        } else if (auto j = std::uniform_int_distribution<std::uint64_t>(0, t)(rng_); j < n_) {
+            slots_[id * n_ + j] = std::move(value);
+        }
+    }
+
+    template <std::ranges::input_range R, class KeyProj, class ValProj>
+    void add_range(R&& r, KeyProj key, ValProj value) {
+        for (auto&& x : r) add(key(x), value(x));
+    }
+
+    void merge(reservoir_accumulator&& other) {
+        std::vector<V> from_a;
+        std::vector<V> from_b;
+        for (std::size_t other_id = 0; other_id < other.size(); ++other_id) {
+            auto id = group_of(other.grouper_.keys[other_id]);
+            auto a = seen_[id];
+            auto b = other.seen_[other_id];
+            auto mine   = values(id);
+            auto theirs = other.values(other_id);
+            from_a.assign(std::make_move_iterator(mine.begin()), std::make_move_iterator(mine.end()));
+            from_b.assign(std::make_move_iterator(theirs.begin()), std::make_move_iterator(theirs.end()));
+
+            auto m = std::min<std::uint64_t>(n_, a + b);
+            for (std::uint64_t i = 0; i < m; ++i) {
+                bool take_a = std::uniform_int_distribution<std::uint64_t>(0, a + b - 1)(rng_) < a;
+                auto& pool  = take_a ? from_a : from_b;
+                --(take_a ? a : b);
+                auto pick = std::uniform_int_distribution<std::size_t>(0, pool.size() - 1)(rng_);
+                slots_[id * n_ + i] = std::move(pool[pick]);
+                pool[pick] = std::move(pool.back());
+                pool.pop_back();
+            }
+            seen_[id] += other.seen_[other_id];
+        }
+        // other keeps its generator state, so reusing it does not replay draws.
+        other.grouper_ = detail::column_grouper<K>{};
+        other.seen_.clear();
+        other.slots_.clear();
+    }
+
+    auto n() const noexcept -> std::size_t { return n_; }
+    auto size() const noexcept -> std::size_t { return seen_.size(); }
+    auto keys() const noexcept -> std::vector<K> const& { return grouper_.keys; }
+    auto seen(std::size_t group) const -> std::uint64_t { return seen_[group]; }
+
+    auto values(std::size_t group) const -> std::span<V const> {
+        return std::span<V const>(slots_).subspan(group * n_, std::min<std::uint64_t>(seen_[group], n_));
+    }
+
+    auto values(std::size_t group) -> std::span<V> {
+        return std::span<V>(slots_).subspan(group * n_, std::min<std::uint64_t>(seen_[group], n_));
+    }
+
+    auto to_map() const -> std::unordered_map<K, std::vector<V>> {
+        std::unordered_map<K, std::vector<V>> out;
+        out.reserve(size());
+        for (std::size_t id = 0; id < size(); ++id) {
+            auto kept = values(id);
+            out.emplace(grouper_.keys[id], std::vector<V>(kept.begin(), kept.end()));
+        }
+        return out;
+    }
+
+private:
+    auto group_of(K const& key) -> std::size_t {
+        auto id = grouper_.resolve_one(key);
+        if (id == seen_.size()) {
+            seen_.push_back(0);
+            slots_.resize(slots_.size() + n_);
+        }
+        return id;
+    }
+
+    std::size_t n_;
+    std::mt19937_64 rng_;
+    detail::column_grouper<K> grouper_;
+    std::vector<std::uint64_t> seen_;
+    std::vector<V> slots_;
+};
+
+template <std::ranges::input_range R, class KeyProj, class ValProj>
+auto sample_by(R&& r, KeyProj key, ValProj value, std::size_t n, std::uint64_t seed = std::mt19937_64::default_seed) {
+    using Ref = std::ranges::range_reference_t<R>;
+    using K   = std::decay_t<std::invoke_result_t<KeyProj&, Ref>>;
+    using V   = std::decay_t<std::invoke_result_t<ValProj&, Ref>>;
+
+    reservoir_accumulator<K, V> acc(n, seed);
+    acc.add_range(std::forward<R>(r), std::move(key), std::move(value));
+    return acc.to_map();
+}
+
+// ---- multiset comparisons ----------------------------------------------
+
+namespace detail {
+
+template <class A, class B>
+constexpr auto build_from_second(A const& a, B const& b) -> bool {
+    if constexpr (std::ranges::sized_range<A> && std::ranges::sized_range<B>) {
+        return std::ranges::size(b) < std::ranges::size(a);
+    } else {
+        return false;
+    }
+}
+
+} // namespace detail
+
+// Per-key minimum of the two multiplicities. Counts only the smaller side and
+// streams the other, erasing keys as they are used up.
+template <std::ranges::input_range A, std::ranges::input_range B, class KeyProj>
+auto intersect_counts_by(A&& a, B&& b, KeyProj key, std::size_t expected_unique = 0) {
+    using K = std::decay_t<std::invoke_result_t<KeyProj&, std::ranges::range_reference_t<A>>>;
+    auto run = [&](auto&& build, auto&& stream) {
+        auto remaining = count_by(build, key, expected_unique);
+        std::unordered_map<K, std::size_t> out;
+        for (auto&& x : stream) {
+            if (remaining.empty()) break;
+            auto it = remaining.find(key(x));
+            if (it == remaining.end()) continue;
+            ++out[it->first];
+            if (--it->second == 0) remaining.erase(it);
+        }
+        return out;
+    };
+    if (detail::build_from_second(a, b)) return run(b, a);
+    return run(a, b);
+}
+
+// Multiplicities of `a` left after removing every element of `b`.
+template <std::ranges::input_range A, std::ranges::input_range B, class KeyProj>
+auto subtract_counts_by(A&& a, B&& b, KeyProj key, std::size_t expected_unique = 0) {
+    using K = std::decay_t<std::invoke_result_t<KeyProj&, std::ranges::range_reference_t<A>>>;
+    if (detail::build_from_second(a, b)) {
+        auto removable = count_by(b, key, expected_unique);
+        std::unordered_map<K, std::size_t> out;
+        for (auto&& x : a) {
+            auto key_value = key(x);
+            auto it = removable.find(key_value);
+            if (it == removable.end()) {
+                ++out[std::move(key_value)];
+            } else if (--it->second == 0) {
+                removable.erase(it);
+            }
+        }
+        return out;
+    }
+    auto out = count_by(a, key, expected_unique);
+    for (auto&& x : b) {
+        auto it = out.find(key(x));
+        if (it != out.end() && --it->second == 0) out.erase(it);
+    }
+    return out;
+}
+
+// True when both ranges hold the same keys with the same multiplicities.
+// Returns as soon as `b` produces a key that `a` has run out of.
+template <std::ranges::input_range A, std::ranges::input_range B, class KeyProj>
+auto equal_counts_by(A&& a, B&& b, KeyProj key, std::size_t expected_unique = 0) -> bool {
+    if constexpr (std::ranges::sized_range<A> && std::ranges::sized_range<B>) {
+        if (std::ranges::size(a) != std::ranges::size(b)) return false;
+    }
+    auto remaining = count_by(a, key, expected_unique);
+    for (auto&& x : b) {
+        auto it = remaining.find(key(x));
+        if (it == remaining.end()) return false;
+        if (--it->second == 0) remaining.erase(it);
+    }
+    return remaining.empty();
+}
+
+// ---- executors ---------------------------------------------------------
+
+template <class E>
+concept executor = requires(E& ex, std::function<void()> task) {
+    ex.execute(std::move(task));
+};
+
+class thread_pool {
+public:
+    explicit thread_pool(std::size_t threads = 0) {
+        auto n = threads ? threads : detail::default_worker_count();
+        workers_.reserve(n);
+        for (std::size_t i = 0; i < n; ++i) {
+            workers_.emplace_back([this] { run(); });
+        }
+    }
+
+    thread_pool(thread_pool const&) = delete;
+    thread_pool& operator=(thread_pool const&) = delete;
+
+    ~thread_pool() {
+        {
+            std::lock_guard lock(mutex_);
+            stopping_ = true;
+        }
+        ready_.notify_all();
+        for (auto& w : workers_) w.join();
+    }
+
+    void execute(std::function<void()> task) {
+        {
+            std::lock_guard lock(mutex_);
+            if (stopping_) throw std::runtime_error("bykey::thread_pool: execute after shutdown");
+            tasks_.push_back(std::move(task));
+        }
+        ready_.notify_one();
+    }
+
+    auto size() const -> std::size_t { return workers_.size(); }
+
+private:
+    void run() {
+        for (;;) {
+            std::function<void()> task;
+            {
+                std::unique_lock lock(mutex_);
+                ready_.wait(lock, [&] { return stopping_ || !tasks_.empty(); });
+                if (tasks_.empty()) return;
+                task = std::move(tasks_.front());
+                tasks_.pop_front();
+            }
+            task();
+        }
+    }
+
+    std::mutex mutex_;
+    std::condition_variable ready_;
+    std::deque<std::function<void()>> tasks_;
+    std::vector<std::thread> workers_;
+    bool stopping_ = false;
+};
+
+// Adapts any "submit this callable" entry point into an executor, e.g. a
+// sender/receiver scheduler:
+//   bykey::make_executor([sch](auto task) {
+//       stdexec::start_detached(stdexec::schedule(sch) | stdexec::then(std::move(task)));
+//   });
+template <class Submit>
+struct function_executor {
+    Submit submit;
+
+    void execute(std::function<void()> task) { submit(std::move(task)); }
+};
+
+template <class Submit>
+auto make_executor(Submit submit) {
+    return function_executor<Submit>{std::move(submit)};
+}
+
+// Process-wide pool used by parallel algorithms when no executor is passed.
+inline auto default_executor() -> thread_pool& {
+    static thread_pool pool;
+    return pool;
+}
+
+// ---- chunked parallel execution -----------------------------------------
+
+struct chunk_options {
+    std::size_t chunk_size = 4096;
+    std::size_t workers    = 0; // 0: std::thread::hardware_concurrency()
+    std::size_t max_queued = 0; // 0: two chunks per worker
+};
+
+namespace mergers {
+
+struct sum_fn {
+    template <class Map>
+    void operator()(Map& into, Map&& from) const {
+        if (into.size() < from.size()) std::swap(into, from);
+        for (auto& [k, v] : from) {
+            auto [it, inserted] = into.try_emplace(k, std::move(v));
+            if (!inserted) it->second += std::move(v);
+        }
+    }
+};
+
+struct append_fn {
+    template <class Value>
+    void operator()(partition_result<Value>& into, partition_result<Value>&& from) const {
+        append(into.falses, std::move(from.falses));
+        append(into.trues, std::move(from.trues));
+    }
+
+    template <class Map>
+    void operator()(Map& into, Map&& from) const {
+        for (auto& [k, bucket] : from) {
+            auto [it, inserted] = into.try_emplace(k, std::move(bucket));
+            if (!inserted) append(it->second, std::move(bucket));
+        }
+    }
+
+private:
+    template <class Bucket>
+    static void append(Bucket& into, Bucket&& from) {
+        into.insert(into.end(), std::make_move_iterator(from.begin()), std::make_move_iterator(from.end()));
+    }
+};
+
+template <class OrderProj, class Compare>
+struct extrema_fn {
+    OrderProj order;
+    Compare comp;
+
+    template <class Map>
+    void operator()(Map& into, Map&& from) const {
+        for (auto& [k, ext] : from) {
+            auto [it, inserted] = into.try_emplace(k, ext);
+            if (inserted) continue;
+            if (comp(order(ext.min), order(it->second.min))) it->second.min = std::move(ext.min);
+            if (comp(order(it->second.max), order(ext.max))) it->second.max = std::move(ext.max);
+        }
+    }
+};
+
+struct member_fn {
+    template <class T>
+    void operator()(T& into, T&& from) const { into.merge(std::move(from)); }
+};
+
+inline constexpr sum_fn sum{};
+inline constexpr append_fn append{};
+inline constexpr member_fn member{};
+
+template <class OrderProj = std::identity, class Compare = std::ranges::less>
+auto extrema(OrderProj order = {}, Compare comp = {}) {
+    return extrema_fn<OrderProj, Compare>{std::move(order), std::move(comp)};
+}
+
+} // namespace mergers
+
+// Pulls fixed-size chunks from any input range on the calling thread and hands
+// them to worker tasks through a bounded shared queue. Each worker runs
+// chunk_fn on the chunks it takes and folds the results into a local partial;
+// partials are merged once the input is exhausted. Chunks reach workers in no
+// particular order, so merge must be associative and commutative. Workers run
+// on the given executor, which must make progress independently of the
+// calling thread (do not pass a pool whose only thread is the caller). By
+// default one pool thread is left free for other users of a shared pool.
+// chunk_fn may call the other executor-aware algorithms on the same pool, but
+// not chunked_reduce itself: the nested producer needs pool threads that are
+// all busy draining the outer stream.
+template <executor Executor, std::ranges::input_range R, class ChunkFn, class MergeFn>
+auto chunked_reduce(Executor& ex, R&& r, ChunkFn chunk_fn, MergeFn merge, chunk_options opts = {}) {
+    using T      = std::ranges::range_value_t<R>;
+    using Chunk  = std::vector<T>;
+    using Result = std::decay_t<std::invoke_result_t<ChunkFn&, Chunk&>>;
+
+    auto workers = opts.workers;
+    if (!workers) {
+        if constexpr (requires { ex.size(); }) workers = std::max<std::size_t>(ex.size(), 2) - 1;
+        else workers = detail::default_worker_count();
+    }
+    auto const chunk_size = std::max<std::size_t>(opts.chunk_size, 1);
+    detail::chunk_queue<T> queue(opts.max_queued ? opts.max_queued : 2 * workers);
+
+    std::vector<std::optional<Result>> partials(workers);
+    detail::task_group group;
+
+    std::exception_ptr producer_error;
+    try {
+        for (std::size_t w = 0; w < workers; ++w) {
+            group.run(ex, [&, w, fn = chunk_fn] () mutable {
+                try {
+                    while (auto chunk = queue.pop()) {
+                        auto part = fn(*chunk);
+                        if (!partials[w]) partials[w].emplace(std::move(part));
+                        else merge(*partials[w], std::move(part));
+                    }
+                } catch (...) {
+                    queue.close();
+                    throw;
+                }
+            });
+        }
+
+        // A failed worker closes the queue; stop reading the source then
+        // rather than chunking the rest of a possibly unbounded input.
+        Chunk chunk;
+        chunk.reserve(chunk_size);
+        for (auto&& x : r) {
+            chunk.push_back(std::forward<decltype(x)>(x));
+            if (chunk.size() == chunk_size) {
+                if (!queue.push(std::move(chunk))) break;
+                chunk = Chunk{};
+                chunk.reserve(chunk_size);
+            }
+        }
+        if (!chunk.empty()) queue.push(std::move(chunk));
+    } catch (...) {
+        producer_error = std::current_exception();
+    }
+    queue.close();
+    try {
+        group.wait();
+    } catch (...) {
+        if (!producer_error) throw;
+    }
+    if (producer_error) std::rethrow_exception(producer_error);
+
+    std::optional<Result> out;
+    for (auto& part : partials) {
+        if (!part) continue;
+        if (!out) out.emplace(std::move(*part));
+        else merge(*out, std::move(*part));
+    }
+    if (!out) {
+        Chunk empty;
+        return Result(chunk_fn(empty));
+    }
+    return Result(std::move(*out));
+}
+
+template <std::ranges::input_range R, class ChunkFn, class MergeFn>
+auto chunked_reduce(R&& r, ChunkFn chunk_fn, MergeFn merge, chunk_options opts = {}) {
+    return chunked_reduce(default_executor(), std::forward<R>(r), std::move(chunk_fn), std::move(merge), opts);
+}
+
+// ---- parallel sampling -------------------------------------------------
+
+namespace detail {
+
+inline constexpr std::size_t sample_chunk_rows = std::size_t{1} << 16;
+
+// Seed of chunk i: the (i + 1)-th splitmix64 output from seed, so chunks draw
+// independent streams that do not depend on which thread runs them.
+constexpr auto chunk_seed(std::uint64_t seed, std::size_t i) -> std::uint64_t {
+    return mix_hash(static_cast<std::size_t>(seed + 0x9e3779b97f4a7c15ULL * (static_cast<std::uint64_t>(i) + 1)));
+}
+
+} // namespace detail
+
+// Parallel variant: fixed-size row chunks are sampled by executor tasks, chunk
+// i seeded from (seed, i), and the partial reservoirs are merged pairwise in
+// chunk order. The result depends only on the input and the seed, not on the
+// executor or its thread count.
+template <executor Executor, std::ranges::random_access_range R, class KeyProj, class ValProj>
+    requires std::ranges::sized_range<R>
+auto sample_by(Executor& ex, R&& r, KeyProj key, ValProj value, std::size_t n,
+               std::uint64_t seed = std::mt19937_64::default_seed) {
+    using Ref = std::ranges::range_reference_t<R>;
+    using K   = std::decay_t<std::invoke_result_t<KeyProj&, Ref>>;
+    using V   = std::decay_t<std::invoke_result_t<ValProj&, Ref>>;
+    using D   = std::ranges::range_difference_t<R>;
+
+    auto rows   = static_cast<std::size_t>(std::ranges::size(r));
+    auto chunks = std::max<std::size_t>((rows + detail::sample_chunk_rows - 1) / detail::sample_chunk_rows, 1);
+    std::vector<reservoir_accumulator<K, V>> parts;
+    parts.reserve(chunks);
+    for (std::size_t c = 0; c < chunks; ++c) parts.emplace_back(n, detail::chunk_seed(seed, c));
+
+    auto first = std::ranges::begin(r);
+    detail::parallel_for(ex, chunks, [&](std::size_t c) {
+        auto lo = c * detail::sample_chunk_rows;
+        auto hi = std::min(rows, lo + detail::sample_chunk_rows);
+        parts[c].add_range(std::ranges::subrange(first + static_cast<D>(lo), first + static_cast<D>(hi)), key, value);
+    });
+
+    for (std::size_t width = 1; width < chunks; width *= 2) {
+        auto merges = (chunks + 2 * width - 1) / (2 * width);
+        detail::parallel_for(ex, merges, [&](std::size_t m) {
+            auto a = 2 * width * m;
+            if (a + width < chunks) parts[a].merge(std::move(parts[a + width]));
+        });
+    }
+    return parts[0].to_map();
+}
+
+// ---- ranking -----------------------------------------------------------
+
+namespace detail {
+
+template <class K, class Compare>
+void sort_rank_pairs(std::vector<std::pair<K, std::uint32_t>>& pairs, Compare& comp) {
+    if constexpr (radix_sortable<K> && (std::same_as<Compare, std::ranges::less> || std::same_as<Compare, std::less<>>)) {
+        radix_sort_pairs(pairs);
+    } else {
+        std::ranges::sort(pairs, comp, [](auto const& p) -> K const& { return p.first; });
+    }
+}
+
+template <std::ranges::input_range R, class KeyProj>
+auto collect_rank_pairs(R&& r, KeyProj& key) {
+    using K = std::decay_t<std::invoke_result_t<KeyProj&, std::ranges::range_reference_t<R>>>;
+    std::vector<std::pair<K, std::uint32_t>> pairs;
+    if constexpr (std::ranges::sized_range<R>) pairs.reserve(std::ranges::size(r));
+    std::uint32_t i = 0;
+    for (auto&& x : r) {
+        if (pairs.size() >= std::numeric_limits<std::uint32_t>::max()) {
+            throw std::length_error("dense_rank_by: too many rows");
+        }
+        pairs.emplace_back(key(x), i++);
+    }
+    return pairs;
+}
+
+template <class K, class Compare>
+auto assign_dense_ranks(std::vector<std::pair<K, std::uint32_t>> const& sorted, Compare& comp) {
+    std::vector<std::size_t> ranks(sorted.size());
+    std::size_t rank = 0;
+    for (std::size_t i = 0; i < sorted.size(); ++i) {
+        if (i == 0 || comp(sorted[i - 1].first, sorted[i].first)) ++rank;
+        ranks[sorted[i].second] = rank;
+    }
+    return ranks;
+}
+
+} // namespace detail
+
+// 1-based dense rank of every element's key, aligned with the input. Sorts
+// (key, position) pairs -- radix sort for integral keys under the default
+// order -- and writes ranks straight into the output, with no hash map.
+// Positions are 32-bit; longer inputs throw std::length_error.
+template <std::ranges::input_range R, class KeyProj, class Compare = std::ranges::less>
+auto dense_rank_by(R&& r, KeyProj key, Compare comp = {}) {
+    auto pairs = detail::collect_rank_pairs(r, key);
+    detail::sort_rank_pairs(pairs, comp);
+    return detail::assign_dense_ranks(pairs, comp);
+}
+
+// Parallel variant: sorts one segment per executor task, then merges the
+// segments pairwise in parallel rounds.
+template <executor Executor, std::ranges::input_range R, class KeyProj, class Compare = std::ranges::less>
+auto dense_rank_by(Executor& ex, R&& r, KeyProj key, Compare comp = {}, std::size_t segments = 0) {
+    auto pairs = detail::collect_rank_pairs(r, key);
+    if (!segments) {
+        if constexpr (requires { ex.size(); }) segments = ex.size();
+        else segments = detail::default_worker_count();
+    }
+    segments = std::clamp<std::size_t>(segments, 1, std::max<std::size_t>(pairs.size() / 1024, 1));
+
+    using Pair = typename decltype(pairs)::value_type;
+    std::vector<std::size_t> bounds(segments + 1);
+    for (std::size_t s = 0; s <= segments; ++s) bounds[s] = pairs.size() * s / segments;
+
+    detail::parallel_for(ex, segments, [&](std::size_t s) {
+        std::vector<Pair> part(std::make_move_iterator(pairs.begin() + bounds[s]),
+                               std::make_move_iterator(pairs.begin() + bounds[s + 1]));
+        detail::sort_rank_pairs(part, comp);
+        std::ranges::move(part, pairs.begin() + bounds[s]);
+    });
+
+    auto by_key = [&comp](Pair const& a, Pair const& b) { return comp(a.first, b.first); };
+    for (std::size_t width = 1; width < segments; width *= 2) {
+        auto merges = (segments + 2 * width - 1) / (2 * width);
+        detail::parallel_for(ex, merges, [&](std::size_t m) {
+            auto lo  = bounds[2 * width * m];
+            auto mid = bounds[std::min(segments, 2 * width * m + width)];
+            auto hi  = bounds[std::min(segments, 2 * width * (m + 1))];
+            std::inplace_merge(pairs.begin() + lo, pairs.begin() + mid, pairs.begin() + hi, by_key);
+        });
+    }
+    return detail::assign_dense_ranks(pairs, comp);
+}
+
+// ---- quantiles ---------------------------------------------------------
+
+namespace detail {
+
+template <class K, class V>
+struct csr_groups {
+    std::vector<K> keys;
+    std::vector<std::size_t> offsets;
+    std::vector<V> values;
+
+    auto group(std::size_t g) -> std::span<V> {
+        return std::span<V>(values).subspan(offsets[g], offsets[g + 1] - offsets[g]);
+    }
+};
+
+// Two passes over buffered rows: dense ids first, then a counting scatter
+// into one contiguous value array.
+template <class R, class KeyProj, class ValProj>
+auto collect_csr(R&& r, KeyProj& key, ValProj& value) {
+    using Ref = std::ranges::range_reference_t<R>;
+    using K   = std::decay_t<std::invoke_result_t<KeyProj&, Ref>>;
+    using V   = std::decay_t<std::invoke_result_t<ValProj&, Ref>>;
+
+    column_grouper<K> grouper;
+    std::vector<std::uint32_t> ids;
+    std::vector<V> rows;
+    if constexpr (std::ranges::sized_range<R>) {
+        ids.reserve(std::ranges::size(r));
+        rows.reserve(std::ranges::size(r));
+    }
+    for (auto&& x : r) {
+        ids.push_back(grouper.resolve_one(key(x)));
+        rows.push_back(value(x));
+    }
+
+    csr_groups<K, V> out;
+    out.keys = std::move(grouper.keys);
+    out.offsets.assign(out.keys.size() + 1, 0);
+    for (auto id : ids) ++out.offsets[id + 1];
+    for (std::size_t g = 1; g < out.offsets.size(); ++g) out.offsets[g] += out.offsets[g - 1];
+
+    std::vector<std::size_t> cursor(out.offsets.begin(), out.offsets.end() - 1);
+    out.values.resize(rows.size());
+    for (std::size_t i = 0; i < rows.size(); ++i) out.values[cursor[ids[i]]++] = std::move(rows[i]);
+    return out;
+}
+
+inline auto quantile_order(std::vector<double> const& qs) -> std::vector<std::size_t> {
+    for (auto q : qs) {
+        if (!(q >= 0.0 && q <= 1.0)) throw std::invalid_argument("bykey: quantiles must lie in [0, 1]");
+    }
+    std::vector<std::size_t> order(qs.size());
+    for (std::size_t i = 0; i < order.size(); ++i) order[i] = i;
+    std::ranges::sort(order, std::ranges::less{}, [&](std::size_t i) { return qs[i]; });
+    return order;
+}
+
+// Lower quantiles (rank floor(q * (n - 1))) by successive nth_element calls;
+// each call only partitions the part of the group above the previous rank.
+template <class V, class Compare>
+void select_quantiles(std::span<V> group, std::vector<double> const& qs, std::vector<std::size_t> const& order,
+                      V* out, Compare& comp) {
+    std::size_t lo = 0;
+    for (auto qi : order) {
+        auto rank = static_cast<std::size_t>(qs[qi] * static_cast<double>(group.size() - 1));
+        if (rank >= lo) {
+            std::ranges::nth_element(group.subspan(lo), group.begin() + static_cast<std::ptrdiff_t>(rank), comp);
+            lo = rank + 1;
+        }
+        out[qi] = group[rank];
+    }
+}
+
+template <class K, class V>
+auto quantile_map(csr_groups<K, V>& groups, std::vector<V>& picked, std::size_t per_group) {
+    std::unordered_map<K, std::vector<V>> out;
+    out.reserve(groups.keys.size());
+    for (std::size_t g = 0; g < groups.keys.size(); ++g) {
+        auto first = picked.begin() + static_cast<std::ptrdiff_t>(g * per_group);
+        out.emplace(std::move(groups.keys[g]), std::vector<V>(first, first + static_cast<std::ptrdiff_t>(per_group)));
+    }
+    return out;
+}
+
+} // namespace detail
+
+template <std::ranges::input_range R, class KeyProj, class ValProj, class Compare = std::ranges::less>
+auto quantiles_by(R&& r, KeyProj key, ValProj value, std::vector<double> const& qs, Compare comp = {}) {
+    auto order  = detail::quantile_order(qs);
+    auto groups = detail::collect_csr(r, key, value);
+    using V = typename decltype(groups.values)::value_type;
+
+    std::vector<V> picked(groups.keys.size() * qs.size());
+    for (std::size_t g = 0; g < groups.keys.size(); ++g) {
+        detail::select_quantiles(groups.group(g), qs, order, picked.data() + g * qs.size(), comp);
+    }
+    return detail::quantile_map(groups, picked, qs.size());
+}
+
+// Parallel variant: groups are split into contiguous batches of roughly equal
+// row counts, one executor task per batch.
+template <executor Executor, std::ranges::input_range R, class KeyProj, class ValProj, class Compare = std::ranges::less>
+auto quantiles_by(Executor& ex, R&& r, KeyProj key, ValProj value, std::vector<double> const& qs, Compare comp = {}) {
+    auto order  = detail::quantile_order(qs);
+    auto groups = detail::collect_csr(r, key, value);
+    using V = typename decltype(groups.values)::value_type;
+
+    std::size_t tasks = 0;
+    if constexpr (requires { ex.size(); }) tasks = 4 * ex.size();
+    else tasks = 4 * detail::default_worker_count();
+    tasks = std::clamp<std::size_t>(tasks, 1, std::max<std::size_t>(groups.keys.size(), 1));
+
+    std::vector<std::size_t> bounds(tasks + 1, groups.keys.size());
+    bounds[0] = 0;
+    auto rows = groups.values.size();
+    for (std::size_t t = 1; t < tasks; ++t) {
+        auto target = rows * t / tasks;
+        bounds[t] = static_cast<std::size_t>(std::ranges::lower_bound(groups.offsets, target) - groups.offsets.begin());
+        bounds[t] = std::clamp(bounds[t], bounds[t - 1], groups.keys.size());
+    }
+
+    std::vector<V> picked(groups.keys.size() * qs.size());
+    detail::parallel_for(ex, tasks, [&](std::size_t t) {
+        auto local = comp;
+        for (auto g = bounds[t]; g < bounds[t + 1]; ++g) {
+            detail::select_quantiles(groups.group(g), qs, order, picked.data() + g * qs.size(), local);
+        }
+    });
+    return detail::quantile_map(groups, picked, qs.size());
+}
+
+// ---- histograms --------------------------------------------------------
+
+// Row-major key x bin count matrix. Column 0 counts values below edges[0],
+// column i counts [edges[i-1], edges[i]), and the last column counts values
+// at or above edges.back().
+template <class K, class T>
+struct histogram_result {
+    std::vector<K> keys;
+    std::vector<T> edges;
+    std::vector<std::size_t> counts;
+
+    auto bins() const noexcept -> std::size_t { return edges.size() + 1; }
+
+    auto row(std::size_t group) const -> std::span<std::size_t const> {
+        return std::span<std::size_t const>(counts).subspan(group * bins(), bins());
+    }
+};
+
+namespace detail {
+
+inline constexpr std::size_t linear_bin_limit = 32;
+
+// Number of edges <= v, i.e. the histogram column of v. Short edge lists are
+// counted with a branch-free loop the compiler can vectorise; longer ones use
+// a branch-free binary search.
+template <class T, class V>
+auto bin_of(std::span<T const> edges, V const& v) -> std::size_t {
+    if (edges.size() <= linear_bin_limit) {
+        std::size_t n = 0;
+        for (auto const& e : edges) n += static_cast<std::size_t>(e <= v);
+        return n;
+    }
+    T const* base = edges.data();
+    for (auto n = edges.size(); n > 1;) {
+        auto half = n / 2;
+        base = base[half] <= v ? base + half : base;
+        n -= half;
+    }
+    return static_cast<std::size_t>(base - edges.data()) + static_cast<std::size_t>(*base <= v);
+}
+
+template <class K, class T, class R, class KeyProj, class ValProj, class BinFn>
+auto fill_histogram(histogram_result<K, T> out, R&& r, KeyProj& key, ValProj& value, BinFn bin) {
+    column_grouper<K> grouper;
+    auto const cols = out.bins();
+    for (auto&& x : r) {
+        auto id = grouper.resolve_one(key(x));
+        if (out.counts.size() < grouper.keys.size() * cols) out.counts.resize(grouper.keys.size() * cols);
+        ++out.counts[id * cols + bin(value(x))];
+    }
+    out.keys = std::move(grouper.keys);
+    return out;
+}
+
+} // namespace detail
+
+template <std::ranges::input_range R, class KeyProj, class ValProj,
+          class T = std::decay_t<std::invoke_result_t<ValProj&, std::ranges::range_reference_t<R>>>>
+auto histogram_by(R&& r, KeyProj key, ValProj value, std::vector<T> edges) {
+    using K = std::decay_t<std::invoke_result_t<KeyProj&, std::ranges::range_reference_t<R>>>;
+    if (edges.empty() || !std::ranges::is_sorted(edges)) {
+        throw std::invalid_argument("bykey: histogram edges must be non-empty and ascending");
+    }
+    histogram_result<K, T> out{{}, std::move(edges), {}};
+    std::span<T const> view(out.edges);
+    return detail::fill_histogram(std::move(out), r, key, value, [view](auto const& v) { return detail::bin_of(view, v); });
+}
+
+// Uniform bins over [lo, hi): the column is computed from the value directly,
+// then nudged by at most one step against the reported edges so rounding never
+// puts a boundary value in a different column than those edges imply.
+template <std::ranges::input_range R, class KeyProj, class ValProj>
+auto histogram_by(R&& r, KeyProj key, ValProj value, double lo, double hi, std::size_t bins) {
+    using K = std::decay_t<std::invoke_result_t<KeyProj&, std::ranges::range_reference_t<R>>>;
+    if (!bins || !(lo < hi)) throw std::invalid_argument("bykey: histogram needs bins > 0 and lo < hi");
+
+    histogram_result<K, double> out;
+    out.edges.resize(bins + 1);
+    auto width = (hi - lo) / static_cast<double>(bins);
+    for (std::size_t i = 0; i <= bins; ++i) out.edges[i] = lo + width * static_cast<double>(i);
+    out.edges.back() = hi;
+
+    auto scale = 1.0 / width;
+    auto last  = static_cast<double>(bins + 1);
+    std::span<double const> edges(out.edges);
+    return detail::fill_histogram(std::move(out), r, key, value, [=](auto const& v) {
+        auto x   = static_cast<double>(v);
+        auto col = static_cast<std::size_t>(std::fmin(std::fmax(std::floor((x - lo) * scale) + 1.0, 0.0), last));
+        if (col > 0 && x < edges[col - 1]) --col;
+        else if (col <= bins && x >= edges[col]) ++col;
+        return col;
+    });
+}
+
+// ---- statistics --------------------------------------------------------
+
+struct welford_state {
+    std::uint64_t count = 0;
+    double mean = 0.0;
+    double m2   = 0.0;
+};
+
+struct welford_result {
+    std::uint64_t count;
+    double mean;
+    double variance;            // sample variance, 0 below two values
+    double population_variance;
+    double stddev;              // sample standard deviation
+};
+
+// Running mean and sum of squared deviations (Welford); partial states merge
+// with Chan et al.'s pairwise update.
+struct welford_traits {
+    auto identity() const -> welford_state { return {}; }
+
+    template <class Value>
+    void combine(welford_state& s, Value const& v) const {
+        auto x = static_cast<double>(v);
+        ++s.count;
+        auto delta = x - s.mean;
+        s.mean += delta / static_cast<double>(s.count);
+        s.m2 += delta * (x - s.mean);
+    }
+
+    void merge(welford_state& into, welford_state&& from) const {
+        if (!from.count) return;
+        if (!into.count) {
+            into = from;
+            return;
+        }
+        auto na = static_cast<double>(into.count);
+        auto nb = static_cast<double>(from.count);
+        auto n  = na + nb;
+        auto delta = from.mean - into.mean;
+        into.mean += delta * nb / n;
+        into.m2 += from.m2 + delta * delta * na * nb / n;
+        into.count += from.count;
+    }
+
+    auto finalize(welford_state const& s) const -> welford_result {
+        auto n = static_cast<double>(s.count);
+        auto variance = s.count > 1 ? s.m2 / (n - 1) : 0.0;
+        return {s.count, s.mean, variance, s.count ? s.m2 / n : 0.0, std::sqrt(variance)};
+    }
+};
+
+struct moments_state {
+    std::uint64_t count = 0;
+    double mean = 0.0;
+    double m2   = 0.0;
+    double m3   = 0.0;
+    double m4   = 0.0;
+};
+
+struct moments_result {
+    std::uint64_t count;
+    double mean;
+    double variance;  // sample variance
+    double stddev;
+    double skewness;  // population (g1)
+    double kurtosis;  // population excess (g2)
+};
+
+// Central moments up to the fourth: Terriberry's online update per value and
+// Pebay's pairwise formulas for merging partial states.
+struct moments_traits {
+    auto identity() const -> moments_state { return {}; }
+
+    template <class Value>
+    void combine(moments_state& s, Value const& v) const {
+        auto x  = static_cast<double>(v);
+        auto n1 = static_cast<double>(s.count);
+        ++s.count;
+        auto n = static_cast<double>(s.count);
+        auto delta    = x - s.mean;
+        auto delta_n  = delta / n;
+        auto delta_n2 = delta_n * delta_n;
+        auto term1    = delta * delta_n * n1;
+        s.mean += delta_n;
+        s.m4 += term1 * delta_n2 * (n * n - 3 * n + 3) + 6 * delta_n2 * s.m2 - 4 * delta_n * s.m3;
+        s.m3 += term1 * delta_n * (n - 2) - 3 * delta_n * s.m2;
+        s.m2 += term1;
+    }
+
+    void merge(moments_state& into, moments_state&& from) const {
+        if (!from.count) return;
+        if (!into.count) {
+            into = from;
+            return;
+        }
+        auto na = static_cast<double>(into.count);
+        auto nb = static_cast<double>(from.count);
+        auto n  = na + nb;
+        auto d  = from.mean - into.mean;
+        auto d2 = d * d;
+
+        auto m2 = into.m2 + from.m2 + d2 * na * nb / n;
+        auto m3 = into.m3 + from.m3 + d2 * d * na * nb * (na - nb) / (n * n)
+                + 3 * d * (na * from.m2 - nb * into.m2) / n;
+        auto m4 = into.m4 + from.m4 + d2 * d2 * na * nb * (na * na - na * nb + nb * nb) / (n * n * n)
+                + 6 * d2 * (na * na * from.m2 + nb * nb * into.m2) / (n * n)
+                + 4 * d * (na * from.m3 - nb * into.m3) / n;
+
+        into.mean += d * nb / n;
+        into.m2 = m2;
+        into.m3 = m3;
+        into.m4 = m4;
+        into.count += from.count;
+    }
+
+    auto finalize(moments_state const& s) const -> moments_result {
+        auto n = static_cast<double>(s.count);
+        auto variance = s.count > 1 ? s.m2 / (n - 1) : 0.0;
+        auto skewness = s.m2 > 0 ? std::sqrt(n) * s.m3 / std::pow(s.m2, 1.5) : 0.0;
+        auto kurtosis = s.m2 > 0 ? n * s.m4 / (s.m2 * s.m2) - 3.0 : 0.0;
+        return {s.count, s.mean, variance, std::sqrt(variance), skewness, kurtosis};
+    }
+};
+
+// Columnar Welford: each run of equal keys is reduced with two plain
+// (vectorisable) passes, a sum and then the squared deviations from the
+// run mean. The run's state is then merged into its key's state, so there
+// is one lookup and one division per run rather than per value.
+template <std::ranges::contiguous_range Keys, std::ranges::contiguous_range Values>
+auto welford_by_columns(Keys const& key_column, Values const& value_column) {
+    using K = std::ranges::range_value_t<Keys>;
+    detail::check_columns(key_column, value_column);
+    auto keys   = detail::as_span(key_column);
+    auto values = detail::as_span(value_column);
+
+    welford_traits traits;
+    detail::column_grouper<K> grouper;
+    std::vector<welford_state> states;
+
+    for (std::size_t i = 0; i < keys.size();) {
+        auto j = i + 1;
+        while (j < keys.size() && keys[j] == keys[i]) ++j;
+
+        auto run = values.subspan(i, j - i);
+        double sum = 0.0;
+        for (auto v : run) sum += static_cast<double>(v);
+        auto mean = sum / static_cast<double>(run.size());
+        double m2 = 0.0;
+        for (auto v : run) {
+            auto d = static_cast<double>(v) - mean;
+            m2 += d * d;
+        }
+
+        auto id = grouper.resolve_one(keys[i]);
+        if (id == states.size()) states.emplace_back();
+        traits.merge(states[id], welford_state{run.size(), mean, m2});
+        i = j;
+    }
+
+    std::vector<welford_result> out;
+    out.reserve(states.size());
+    for (auto const& st : states) out.push_back(traits.finalize(st));
+    return column_result<K, welford_result>{std::move(grouper.keys), std::move(out)};
+}
+
+// ---- coroutines --------------------------------------------------------
+
+// Lazily started coroutine generator whose body may co_await (I/O, timers,
+// other generators). Consumers pull items with `co_await gen.next()`, which
+// yields std::nullopt once the body finishes. Control passes between producer
+// and consumer by symmetric transfer, so no thread is parked per stream.
+template <class T>
+class async_generator {
+public:
+    struct promise_type {
+        std::optional<T> current;
+        std::coroutine_handle<> consumer;
+        std::exception_ptr error;
+
+        auto get_return_object() -> async_generator {
+            return async_generator{std::coroutine_handle<promise_type>::from_promise(*this)};
+        }
+
+        auto initial_suspend() noexcept -> std::suspend_always { return {}; }
+
+        struct yield_awaiter {
+            auto await_ready() noexcept -> bool { return false; }
+            auto await_suspend(std::coroutine_handle<promise_type> h) noexcept -> std::coroutine_handle<> {
+                return h.promise().consumer;
+            }
+            void await_resume() noexcept {}
+        };
+
+        auto yield_value(T value) -> yield_awaiter {
+            current.emplace(std::move(value));
+            return {};
+        }
+
+        auto final_suspend() noexcept -> yield_awaiter { return {}; }
+
+        void return_void() {}
+        void unhandled_exception() { error = std::current_exception(); }
+    };
+
+    async_generator(async_generator&& other) noexcept : handle_(std::exchange(other.handle_, {})) {}
+
+    async_generator& operator=(async_generator&& other) noexcept {
+        if (this != &other) {
+            if (handle_) handle_.destroy();
+            handle_ = std::exchange(other.handle_, {});
+        }
+        return *this;
+    }
+
+    ~async_generator() {
+        if (handle_) handle_.destroy();
+    }
+
+    auto next() {
+        struct awaiter {
+            std::coroutine_handle<promise_type> producer;
+
+            auto await_ready() const noexcept -> bool { return !producer || producer.done(); }
+
+            auto await_suspend(std::coroutine_handle<> consumer) noexcept -> std::coroutine_handle<> {
+                producer.promise().consumer = consumer;
+                producer.promise().current.reset();
+                return producer;
+            }
+
+            auto await_resume() -> std::optional<T> {
+                if (!producer) return std::nullopt;
+                auto& promise = producer.promise();
+                if (promise.error) std::rethrow_exception(std::exchange(promise.error, nullptr));
+                if (producer.done()) return std::nullopt;
+                return std::move(promise.current);
+            }
+        };
+        return awaiter{handle_};
+    }
+
+private:
+    explicit async_generator(std::coroutine_handle<promise_type> h) : handle_(h) {}
+
+    std::coroutine_handle<promise_type> handle_;
+};
+
+namespace detail {
+
+// Items are fed to the aggregation one by one; a source may also yield whole
+// batches (any range whose elements the key projection accepts).
+template <class KeyProj, class Item, class F>
+void for_each_item(Item& item, F&& f) {
+    if constexpr (std::invocable<KeyProj&, Item&>) {
+        f(item);
+    } else {
+        for (auto&& x : item) f(x);
+    }
+}
+
+template <class Item, class KeyProj>
+struct item_key {
+    using type = std::decay_t<std::invoke_result_t<KeyProj&, Item&>>;
+};
+
+template <std::ranges::range Item, class KeyProj>
+    requires (!std::invocable<KeyProj&, Item&>)
+struct item_key<Item, KeyProj> {
+    using type = std::decay_t<std::invoke_result_t<KeyProj&, std::ranges::range_reference_t<Item&>>>;
+};
+
+template <class Item, class KeyProj>
+using item_key_t = typename item_key<Item, KeyProj>::type;
+
+} // namespace detail
+
+// Yields a copy of the running table every `snapshot_every` items (0: never)
+// and the final table once the source is exhausted, unless the last snapshot
+// already is the final table.
+template <class T, class KeyProj>
+auto async_count_by(async_generator<T> source, KeyProj key, std::size_t snapshot_every = 0)
+    -> async_generator<std::unordered_map<detail::item_key_t<T, KeyProj>, std::size_t>> {
+    std::unordered_map<detail::item_key_t<T, KeyProj>, std::size_t> freq;
+    std::size_t since_snapshot = 0;
+    bool snapshot_due = false;
+    bool yielded = false;
+    bool unsnapshotted = false;
+
+    while (auto item = co_await source.next()) {
+        detail::for_each_item<KeyProj>(*item, [&](auto&& x) {
+            ++freq[key(x)];
+            unsnapshotted = true;
+            if (snapshot_every && ++since_snapshot == snapshot_every) {
+                since_snapshot = 0;
+                snapshot_due = true;
+            }
+        });
+        if (snapshot_due) {
+            snapshot_due = false;
+            yielded = true;
+            unsnapshotted = false;
+            co_yield freq;
+        }
+    }
+    if (unsnapshotted || !yielded) co_yield std::move(freq);
+}
+
+template <class T, class KeyProj, class ValProj, class Traits>
+auto async_transform_reduce_by(async_generator<T> source, KeyProj key, ValProj value, Traits traits,
+                               std::size_t snapshot_every = 0)
+    -> async_generator<decltype(detail::finalize_map(
+           traits,
+           std::unordered_map<detail::item_key_t<T, KeyProj>, std::decay_t<decltype(traits.identity())>>{}))> {
+    using K   = detail::item_key_t<T, KeyProj>;
+    using Acc = std::decay_t<decltype(traits.identity())>;
+
+    std::unordered_map<K, Acc> accs;
+    std::size_t since_snapshot = 0;
+    bool snapshot_due = false;
+    bool yielded = false;
+    bool unsnapshotted = false;
+
+    while (auto item = co_await source.next()) {
+        detail::for_each_item<KeyProj>(*item, [&](auto&& x) {
+            auto key_value = key(x);
+            auto value_copy = value(x);
+            auto [it, inserted] = accs.try_emplace(key_value, traits.identity());
+            traits.combine(it->second, std::move(value_copy));
+            unsnapshotted = true;
+            if (snapshot_every && ++since_snapshot == snapshot_every) {
+                since_snapshot = 0;
+                snapshot_due = true;
+            }
+        });
+        if (snapshot_due) {
+            snapshot_due = false;
+            yielded = true;
+            unsnapshotted = false;
+            co_yield detail::finalize_map(traits, accs);
+        }
+    }
+    if (unsnapshotted || !yielded) co_yield detail::finalize_map(traits, std::move(accs));
+}
+
+template <class T, class KeyProj, class ValProj, class Acc, class BinaryOp>
+    requires (!std::integral<BinaryOp>)
+auto async_transform_reduce_by(async_generator<T> source, KeyProj key, ValProj value, Acc init, BinaryOp combine,
+                               std::size_t snapshot_every = 0) {
+    auto traits = detail::basic_transform_traits<Acc, BinaryOp>{std::move(init), std::move(combine)};
+    return async_transform_reduce_by(std::move(source), std::move(key), std::move(value), std::move(traits), snapshot_every);
+}
+
+// ---- ingestion pipeline ------------------------------------------------
+
+// Bounded lock-free queue for exactly one producer thread and one consumer
+// thread. Head and tail live on separate cache lines, and each side caches the
+// other's index so the shared atomics are only re-read when the queue looks
+// full or empty.
+template <class T>
+class spsc_ring {
+public:
+    explicit spsc_ring(std::size_t capacity)
+        : mask_(std::bit_ceil(std::max<std::size_t>(capacity, 2)) - 1),
+          slots_(std::make_unique<std::optional<T>[]>(mask_ + 1)) {}
+
+    template <class U>
+    auto try_push(U&& value) -> bool {
+        auto tail = tail_.load(std::memory_order_relaxed);
+        if (tail - cached_head_ > mask_) {
+            cached_head_ = head_.load(std::memory_order_acquire);
+            if (tail - cached_head_ > mask_) return false;
+        }
+        slots_[tail & mask_].emplace(std::forward<U>(value));
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Hands up to max_items queued values to sink(T&&); returns how many.
+    template <class Sink>
+    auto pop_batch(Sink&& sink, std::size_t max_items) -> std::size_t {
+        auto head = head_.load(std::memory_order_relaxed);
+        if (head == cached_tail_) {
+            cached_tail_ = tail_.load(std::memory_order_acquire);
+            if (head == cached_tail_) return 0;
+        }
+        auto n = std::min<std::size_t>(cached_tail_ - head, max_items);
+        for (std::size_t i = 0; i < n; ++i) {
+            auto& slot = slots_[(head + i) & mask_];
+            sink(std::move(*slot));
+            slot.reset();
+        }
+        head_.store(head + n, std::memory_order_release);
+        return n;
+    }
+
+    auto size() const -> std::size_t {
+        return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire);
+    }
+
+    auto capacity() const -> std::size_t { return mask_ + 1; }
+
+private:
+    std::size_t mask_;
+    std::unique_ptr<std::optional<T>[]> slots_;
+    alignas(detail::cache_line_size) std::atomic<std::size_t> head_{0};
+    std::size_t cached_tail_ = 0;
+    alignas(detail::cache_line_size) std::atomic<std::size_t> tail_{0};
+    std::size_t cached_head_ = 0;
+};
+
+struct pipeline_options {
+    std::size_t capacity   = 1 << 14;
+    std::size_t batch_size = 256;
+    std::function<void()> on_start{}; // runs first on the aggregator thread, e.g. to pin it to a core
+};
+
+struct pipeline_stats {
+    std::size_t pushed             = 0;
+    std::size_t batches            = 0;
+    std::size_t backpressure_waits = 0; // push() calls that found the ring full
+    std::size_t max_depth          = 0; // deepest queue seen by the aggregator
+};
+
+// A parser thread push()es records into an spsc_ring; a dedicated aggregator
+// thread drains it in batches into a per-key table, so only that thread ever
+// touches the table. finish() stops the thread and returns the table.
+template <class Record, class KeyProj, class ValProj, class Traits>
+class aggregation_pipeline {
+public:
+    using key_type   = std::decay_t<std::invoke_result_t<KeyProj&, Record&>>;
+    using state_type = std::decay_t<decltype(std::declval<Traits const&>().identity())>;
+
+    aggregation_pipeline(KeyProj key, ValProj value, Traits traits, pipeline_options opts = {})
+        : key_(std::move(key)),
+          value_(std::move(value)),
+          traits_(std::move(traits)),
+          batch_size_(std::max<std::size_t>(opts.batch_size, 1)),
+          ring_(opts.capacity),
+          worker_([this, on_start = std::move(opts.on_start)] {
+              try {
+                  if (on_start) on_start();
+                  drain();
+              } catch (...) {
+                  error_ = std::current_exception();
+                  failed_.store(true, std::memory_order_release);
+              }
+          }) {}
+
+    aggregation_pipeline(aggregation_pipeline const&) = delete;
+    aggregation_pipeline& operator=(aggregation_pipeline const&) = delete;
+
+    ~aggregation_pipeline() { stop(); }
+
+    // On false the record is left untouched, so the caller can retry it.
+    auto try_push(Record&& record) -> bool { return try_push_impl(std::move(record)); }
+    auto try_push(Record const& record) -> bool { return try_push_impl(record); }
+
+    void push(Record record) {
+        if (try_push_impl(std::move(record))) return;
+        backpressure_.fetch_add(1, std::memory_order_relaxed);
+        while (!try_push_impl(std::move(record))) std::this_thread::yield();
+    }
+
+    auto depth() const -> std::size_t { return ring_.size(); }
+
+    auto stats() const -> pipeline_stats {
+        return pipeline_stats{
+            pushed_.load(std::memory_order_relaxed),
+            batches_.load(std::memory_order_relaxed),
+            backpressure_.load(std::memory_order_relaxed),
+            max_depth_.load(std::memory_order_relaxed)};
+    }
+
+    // Drains what is queued, joins the aggregator thread and returns the table.
+    // Later calls return the same table; pushing after finish() throws. If a
+    // projection or combine threw on the aggregator thread, draining stopped
+    // there and finish() (like any later push) rethrows that exception.
+    auto finish() -> auto const& {
+        if (!result_) {
+            stop();
+            if (error_) std::rethrow_exception(error_);
+            result_.emplace(detail::finalize_map(traits_, std::move(accs_)));
+        }
+        return *result_;
+    }
+
+private:
+    using result_type = decltype(detail::finalize_map(std::declval<Traits&>(),
+                                                      std::declval<std::unordered_map<key_type, state_type>>()));
+
+    template <class R>
+    auto try_push_impl(R&& record) -> bool {
+        if (failed_.load(std::memory_order_acquire)) std::rethrow_exception(error_);
+        if (closed_.load(std::memory_order_relaxed)) {
+            throw std::runtime_error("bykey::aggregation_pipeline: push after finish");
+        }
+        if (!ring_.try_push(std::forward<R>(record))) return false;
+        pushed_.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    void stop() {
+        if (!worker_.joinable()) return;
+        closed_.store(true, std::memory_order_release);
+        worker_.join();
+    }
+
+    void drain() {
+        auto sink = [&](Record&& record) {
+            auto key_value = key_(record);
+            auto value_copy = value_(record);
+            auto [it, inserted] = accs_.try_emplace(std::move(key_value), traits_.identity());
+            traits_.combine(it->second, std::move(value_copy));
+        };
+        for (;;) {
+            auto depth = ring_.size();
+            if (depth > max_depth_.load(std::memory_order_relaxed)) {
+                max_depth_.store(depth, std::memory_order_relaxed);
+            }
+            if (ring_.pop_batch(sink, batch_size_)) {
+                batches_.fetch_add(1, std::memory_order_relaxed);
+                continue;
+            }
+            if (closed_.load(std::memory_order_acquire)) {
+                while (ring_.pop_batch(sink, batch_size_)) batches_.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            std::this_thread::yield();
+        }
+    }
+
+    KeyProj key_;
+    ValProj value_;
+    Traits traits_;
+    std::size_t batch_size_;
+    std::unordered_map<key_type, state_type> accs_;
+    std::optional<result_type> result_;
+    spsc_ring<Record> ring_;
+
+    std::atomic<bool> closed_{false};
+    std::atomic<bool> failed_{false}; // set once error_ holds the aggregator thread's exception
+    std::exception_ptr error_;
+    std::atomic<std::size_t> pushed_{0};
+    std::atomic<std::size_t> batches_{0};
+    std::atomic<std::size_t> backpressure_{0};
+    std::atomic<std::size_t> max_depth_{0};
+
+    std::thread worker_; // declared last: starts once every other member exists
+};
+
+template <class Record, class KeyProj, class ValProj, class Traits>
+auto make_aggregation_pipeline(KeyProj key, ValProj value, Traits traits, pipeline_options opts = {}) {
+    return std::make_unique<aggregation_pipeline<Record, KeyProj, ValProj, Traits>>(
+        std::move(key), std::move(value), std::move(traits), std::move(opts));
+}
+
+template <class Record, class KeyProj>
+auto make_count_pipeline(KeyProj key, pipeline_options opts = {}) {
+    return make_aggregation_pipeline<Record>(std::move(key), detail::unit_projection{}, detail::count_traits{}, std::move(opts));
+}
+
+// ---- concurrent aggregation -------------------------------------------
+
+// Keys hash to one of a power-of-two number of shards, each guarded by its own
+// mutex, so writers on different keys rarely meet on the same lock.
+template <class K, class Traits, class Hash = std::hash<K>, class KeyEqual = std::equal_to<K>>
+class concurrent_aggregator {
+public:
+    using key_type   = K;
+    using key_equal  = KeyEqual;
+    using state_type = std::decay_t<decltype(std::declval<Traits const&>().identity())>;
+    using map_type   = std::unordered_map<K, state_type, Hash, KeyEqual>;
+
+    explicit concurrent_aggregator(Traits traits = {}, std::size_t shard_count = 64, Hash hash = {}, KeyEqual eq = {})
+        : traits_(std::move(traits)),
+          hash_(std::move(hash)),
+          eq_(std::move(eq)),
+          shard_count_(std::bit_ceil(std::max<std::size_t>(shard_count, 1))),
+          shards_(std::make_unique<shard[]>(shard_count_)) {
+        for (std::size_t i = 0; i < shard_count_; ++i) shards_[i].states = map_type(0, hash_, eq_);
+    }
+
+    template <class Value>
+    void add(K const& key, Value&& v) {
+        auto& sh = shard_for(key);
+        std::lock_guard lock(sh.mutex);
+        auto [it, inserted] = sh.states.try_emplace(key, traits_.identity());
+        traits_.combine(it->second, std::forward<Value>(v));
+    }
+
+    // Folds an already combined partial state into the shard via Traits::merge.
+    void merge(K const& key, state_type&& partial) {
+        static_assert(detail::has_merge<Traits, state_type>,
+                      "concurrent_aggregator::merge requires Traits::merge(state&, state&&)");
+        auto& sh = shard_for(key);
+        std::lock_guard lock(sh.mutex);
+        auto it = sh.states.find(key);
+        if (it == sh.states.end()) sh.states.emplace(key, std::move(partial));
+        else traits_.merge(it->second, std::move(partial));
+    }
+
+    template <std::ranges::input_range R, class KeyProj, class ValProj = std::identity>
+    void add_range(R&& r, KeyProj key, ValProj value = {}) {
+        for (auto&& x : r) {
+            auto key_value = key(x);
+            add(key_value, value(x));
+        }
+    }
+
+    auto shard_count() const -> std::size_t { return shard_count_; }
+    auto traits() const -> Traits const& { return traits_; }
+    auto hash_function() const -> Hash { return hash_; }
+    auto key_eq() const -> KeyEqual { return eq_; }
+
+    // Copies every shard under its lock; writers may keep running.
+    auto snapshot() const& {
+        map_type out(0, hash_, eq_);
+        for (std::size_t i = 0; i < shard_count_; ++i) {
+            std::lock_guard lock(shards_[i].mutex);
+            out.insert(shards_[i].states.begin(), shards_[i].states.end());
+        }
+        return detail::finalize_map(traits_, std::move(out));
+    }
+
+    // Splices the shard nodes into one map without copying keys or states.
+    auto snapshot() && {
+        map_type out(0, hash_, eq_);
+        std::size_t total = 0;
+        for (std::size_t i = 0; i < shard_count_; ++i) total += shards_[i].states.size();
+        detail::try_reserve(out, total);
+        for (std::size_t i = 0; i < shard_count_; ++i) {
+            std::lock_guard lock(shards_[i].mutex);
+            out.merge(shards_[i].states);
+        }
+        return detail::finalize_map(traits_, std::move(out));
+    }
+
+private:
+    struct alignas(detail::cache_line_size) shard {
+        mutable std::mutex mutex;
+        map_type states;
+    };
+
+    auto shard_for(K const& key) -> shard& {
+        auto h = detail::mix_hash(hash_(key));
+        return shards_[h & (shard_count_ - 1)];
+    }
+
+    Traits traits_;
+    Hash hash_;
+    KeyEqual eq_;
+    std::size_t shard_count_;
+    std::unique_ptr<shard[]> shards_;
+};
+
+template <class K, class V, class Hash = std::hash<K>, class KeyEqual = std::equal_to<K>>
+using concurrent_grouper = concurrent_aggregator<K, detail::append_traits<std::vector<V>>, Hash, KeyEqual>;
+
+// Per-thread front for a concurrent_aggregator: a small direct-mapped cache of
+// partial states. A slot is merged into the global table when another key
+// evicts it, on flush(), and on destruction. Not thread-safe; give each
+// writer thread its own combiner. Keys compare with the aggregator's KeyEqual.
+// The destructor swallows errors from the final merge; call flush() first
+// when they must be observed.
+template <class Aggregator>
+class local_combiner {
+public:
+    using key_type   = typename Aggregator::key_type;
+    using key_equal  = typename Aggregator::key_equal;
+    using state_type = typename Aggregator::state_type;
+
+    explicit local_combiner(Aggregator& global, std::size_t slots = 256)
+        : global_(&global),
+          slots_(std::bit_ceil(std::max<std::size_t>(slots, 1))),
+          eq_(global.key_eq()) {}
+
+    local_combiner(local_combiner const&) = delete;
+    local_combiner& operator=(local_combiner const&) = delete;
+
+    ~local_combiner() {
+        try {
+            flush();
+        } catch (...) {
+        }
+    }
+
+    template <class Value>
+    void add(key_type const& key, Value&& v) {
+        auto h = detail::mix_hash(global_->hash_function()(key));
+        auto& slot = slots_[h & (slots_.size() - 1)];
+        if (!slot || !eq_(slot->first, key)) {
+            if (slot) {
+                ++evictions_;
+                global_->merge(slot->first, std::move(slot->second));
+            }
+            slot.emplace(key, global_->traits().identity());
+        }
+        global_->traits().combine(slot->second, std::forward<Value>(v));
+    }
+
+    // Ends an epoch: every cached partial becomes visible in the global table.
+    void flush() {
+        for (auto& slot : slots_) {
+            if (!slot) continue;
+            global_->merge(slot->first, std::move(slot->second));
+            slot.reset();
+        }
+    }
+
+    auto evictions() const -> std::size_t { return evictions_; }
+
+private:
+    Aggregator* global_;
+    std::vector<std::optional<std::pair<key_type, state_type>>> slots_;
+    key_equal eq_;
+    std::size_t evictions_ = 0;
+};
+
+// ---- live snapshots ----------------------------------------------------
+
+// Writers fold into a private live table; publish() freezes the keys changed
+// since the previous publish into an immutable layer stacked on the previous
+// snapshot, so publishing costs O(changed keys). Every max_layers publishes the
+// chain is flattened into a single layer. Readers only copy a shared_ptr and
+// never contend with add().
+template <class K, class Traits, class Hash = std::hash<K>, class KeyEqual = std::equal_to<K>>
+class live_aggregator {
+public:
+    using key_type   = K;
+    using state_type = std::decay_t<decltype(std::declval<Traits const&>().identity())>;
+    using map_type   = std::unordered_map<K, state_type, Hash, KeyEqual>;
+
+private:
+    struct layer {
+        map_type states;
+        std::shared_ptr<layer const> parent;
+        std::size_t depth = 0;
+        std::size_t key_count = 0;
+        std::uint64_t version = 0;
+    };
+
+public:
+    class snapshot_type {
+    public:
+        auto find(K const& key) const -> state_type const* {
+            for (auto* l = head_.get(); l; l = l->parent.get()) {
+                auto it = l->states.find(key);
+                if (it != l->states.end()) return &it->second;
+            }
+            return nullptr;
+        }
+
+        auto contains(K const& key) const -> bool { return find(key) != nullptr; }
+
+        auto at(K const& key) const {
+            auto const* st = find(key);
+            if (!st) throw std::out_of_range("bykey::live_aggregator snapshot: key not found");
+            if constexpr (detail::has_finalize<Traits, state_type>) return traits_.finalize(*st);
+            else return *st;
+        }
+
+        auto size() const -> std::size_t { return head_->key_count; }
+        auto version() const -> std::uint64_t { return head_->version; }
+
+        auto to_map() const {
+            map_type out;
+            detail::try_reserve(out, size());
+            for (auto* l = head_.get(); l; l = l->parent.get()) {
+                for (auto const& [k, st] : l->states) out.try_emplace(k, st);
+            }
+            return detail::finalize_map(traits_, std::move(out));
+        }
+
+    private:
+        friend class live_aggregator;
+
+        snapshot_type(std::shared_ptr<layer const> head, Traits traits)
+            : head_(std::move(head)), traits_(std::move(traits)) {}
+
+        std::shared_ptr<layer const> head_;
+        Traits traits_;
+    };
+
+    explicit live_aggregator(Traits traits = {}, std::size_t max_layers = 8)
+        : traits_(std::move(traits)),
+          max_layers_(std::max<std::size_t>(max_layers, 1)),
+          head_(std::make_shared<layer const>()) {}
+
+    template <class Value>
+    void add(K const& key, Value&& v) {
+        std::lock_guard lock(write_mutex_);
+        auto [it, inserted] = live_.try_emplace(key, entry{traits_.identity(), false});
+        traits_.combine(it->second.state, std::forward<Value>(v));
+        if (!it->second.dirty) {
+            it->second.dirty = true;
+            changed_.push_back(key);
+        }
+    }
+
+    // Only copying the changed states happens under the writer lock; the new
+    // layer, and every max_layers-th flatten of the previous snapshot, is
+    // built outside it so add() never waits on O(total keys) work.
+    auto publish() -> std::uint64_t {
+        std::lock_guard publish_lock(publish_mutex_);
+        std::vector<std::pair<K, state_type>> changed;
+        std::size_t key_count = 0;
+        {
+            std::lock_guard lock(write_mutex_);
+            changed.reserve(changed_.size());
+            for (auto& k : changed_) {
+                auto& e = live_.find(k)->second;
+                e.dirty = false;
+                changed.emplace_back(std::move(k), e.state);
+            }
+            changed_.clear();
+            key_count = live_.size();
+        }
+
+        auto prev = current();
+        auto next = std::make_shared<layer>();
+        if (prev->depth + 1 >= max_layers_) {
+            detail::try_reserve(next->states, key_count);
+            for (auto& [k, st] : changed) next->states.insert_or_assign(std::move(k), std::move(st));
+            for (auto* l = prev.get(); l; l = l->parent.get()) {
+                for (auto const& [k, st] : l->states) next->states.try_emplace(k, st);
+            }
+        } else {
+            detail::try_reserve(next->states, changed.size());
+            for (auto& [k, st] : changed) next->states.emplace(std::move(k), std::move(st));
+            next->parent = prev;
+            next->depth  = prev->depth + 1;
+        }
+
+        next->key_count = key_count;
+        next->version   = prev->version + 1;
+        auto version    = next->version;
+        {
+            std::lock_guard swap_lock(head_mutex_);
+            head_ = std::move(next);
+        }
+        return version;
+    }
+
+    auto snapshot() const -> snapshot_type { return snapshot_type{current(), traits_}; }
+
+private:
+    struct entry {
+        state_type state;
+        bool dirty;
+    };
+
+    auto current() const -> std::shared_ptr<layer const> {
+        std::lock_guard lock(head_mutex_);
+        return head_;
+    }
+
+    Traits traits_;
+    std::size_t max_layers_;
+
+    std::mutex publish_mutex_;
+    std::mutex write_mutex_;
+    std::unordered_map<K, entry, Hash, KeyEqual> live_;
+    std::vector<K> changed_;
+
+    mutable std::mutex head_mutex_;
+    std::shared_ptr<layer const> head_;
+};
+
+// ---- bloom prefilter ----------------------------------------------------
+
+// Split-block Bloom filter: a key maps to one cache-line block and sets one
+// bit in each of its eight 64-bit words, so a probe touches a single line and
+// the word checks are independent (the check loop vectorises).
+template <class K, class Hash = std::hash<K>>
+class blocked_bloom {
+public:
+    explicit blocked_bloom(std::size_t expected_keys, std::size_t bits_per_key = 10, Hash hash = {})
+        : blocks_(std::max<std::size_t>((expected_keys * bits_per_key + block_bits - 1) / block_bits, 1)),
+          hash_(std::move(hash)) {}
+
+    void insert(K const& key) { insert_hash(hash_(key)); }
+    auto may_contain(K const& key) const -> bool { return may_contain_hash(hash_(key)); }
+
+    void insert_hash(std::size_t h) {
+        auto x = detail::mix_hash(h);
+        auto& b = blocks_[block_of(x)];
+        for (std::size_t i = 0; i < words; ++i) b.words[i] |= bit_of(x, i);
+    }
+
+    auto may_contain_hash(std::size_t h) const -> bool {
+        auto x = detail::mix_hash(h);
+        auto const& b = blocks_[block_of(x)];
+        std::uint64_t missing = 0;
+        for (std::size_t i = 0; i < words; ++i) missing |= ~b.words[i] & bit_of(x, i);
+        return missing == 0;
+    }
+
+    auto block_count() const -> std::size_t { return blocks_.size(); }
+
+private:
+    static constexpr std::size_t words      = 8;
+    static constexpr std::size_t block_bits = words * 64;
+
+    struct alignas(detail::cache_line_size) block {
+        std::uint64_t words[8] = {};
+    };
+
+    auto block_of(std::uint64_t x) const -> std::size_t {
+        return static_cast<std::size_t>(((x >> 32) * blocks_.size()) >> 32);
+    }
+
+    static auto bit_of(std::uint64_t x, std::size_t i) -> std::uint64_t {
+        constexpr std::uint32_t salts[words] = {0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+                                                0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U};
+        auto lo = static_cast<std::uint32_t>(x);
+        return std::uint64_t{1} << ((lo * salts[i]) >> 26);
+    }
+
+    std::vector<block> blocks_;
+    Hash hash_;
+};
+
+// A lookup map with a blocked_bloom over its keys: misses are answered from
+// one cache line without probing the map.
+template <class Map>
+class prefiltered {
+public:
+    using key_type    = typename Map::key_type;
+    using mapped_type = typename Map::mapped_type;
+
+    explicit prefiltered(Map map, std::size_t bits_per_key = 10)
+        : map_(std::move(map)),
+          filter_(map_.size(), bits_per_key, map_.hash_function()) {
+        for (auto const& kv : map_) filter_.insert(kv.first);
+    }
+
+    auto find(key_type const& key) const {
+        if (!filter_.may_contain(key)) return map_.end();
+        return map_.find(key);
+    }
+
+    auto contains(key_type const& key) const -> bool { return find(key) != map_.end(); }
+    auto count(key_type const& key) const -> std::size_t { return contains(key) ? 1 : 0; }
+
+    auto at(key_type const& key) const -> mapped_type const& {
+        auto it = find(key);
+        if (it == map_.end()) throw std::out_of_range("bykey::prefiltered: key not found");
+        return it->second;
+    }
+
+    auto size() const -> std::size_t { return map_.size(); }
+    auto begin() const { return map_.begin(); }
+    auto end() const { return map_.end(); }
+
+    auto map() const -> Map const& { return map_; }
+    auto filter() const -> blocked_bloom<key_type, typename Map::hasher> const& { return filter_; }
+
+private:
+    Map map_;
+    blocked_bloom<key_type, typename Map::hasher> filter_;
+};
+
+template <class Map>
+auto make_prefiltered(Map map, std::size_t bits_per_key = 10) {
+    return prefiltered<Map>(std::move(map), bits_per_key);
+}
+
+// ---- joins -------------------------------------------------------------
+
+struct join_options {
+    bool bloom_prefilter     = false; // consult a blocked_bloom before each build-side probe
+    std::size_t bits_per_key = 10;
+};
+
+namespace join_mode {
+
+struct inner_t { explicit inner_t() = default; };
+struct left_semi_t { explicit left_semi_t() = default; };
+struct left_anti_t { explicit left_anti_t() = default; };
+
+inline constexpr inner_t inner{};
+inline constexpr left_semi_t left_semi{};
+inline constexpr left_anti_t left_anti{};
+
+} // namespace join_mode
+
+namespace detail {
+
+// Build-side rows bucketed by key in one contiguous array: rows of group g
+// occupy [offsets[g], offsets[g + 1]). Offsets are 32-bit, so the build side
+// is limited to 2^32 - 1 rows.
+template <class K, class It>
+struct join_table {
+    std::unordered_map<K, std::uint32_t> groups;
+    std::vector<std::uint32_t> offsets;
+    std::vector<It> rows;
+    std::optional<blocked_bloom<K>> filter;
+
+    auto span_of(K const& key) const -> std::pair<std::uint32_t, std::uint32_t> {
+        if (filter && !filter->may_contain(key)) return {0, 0};
+        auto it = groups.find(key);
+        if (it == groups.end()) return {0, 0};
+        return {offsets[it->second], offsets[it->second + 1]};
+    }
+};
+
+template <class K, class V, class KeyProj>
+auto build_join_table(V& v, KeyProj& key, join_options const& opts) {
+    using It = std::ranges::iterator_t<V>;
+    join_table<K, It> table;
+    std::vector<std::uint32_t> row_group;
+    std::vector<It> its;
+    std::vector<std::uint32_t> counts;
+
+    if constexpr (std::ranges::sized_range<V>) {
+        row_group.reserve(std::ranges::size(v));
+        its.reserve(std::ranges::size(v));
+    }
+    for (auto it = std::ranges::begin(v); it != std::ranges::end(v); ++it) {
+        if (its.size() >= std::numeric_limits<std::uint32_t>::max()) {
+            throw std::length_error("join_by: too many build-side rows");
+        }
+        auto [g, inserted] = table.groups.try_emplace(K(key(*it)), static_cast<std::uint32_t>(counts.size()));
+        if (inserted) counts.push_back(0);
+        ++counts[g->second];
+        row_group.push_back(g->second);
+        its.push_back(it);
+    }
+
+    table.offsets.assign(counts.size() + 1, 0);
+    for (std::size_t g = 0; g < counts.size(); ++g) table.offsets[g + 1] = table.offsets[g] + counts[g];
+    auto cursor = std::vector<std::uint32_t>(table.offsets.begin(), table.offsets.end() - 1);
+    table.rows.resize(its.size());
+    for (std::size_t i = 0; i < its.size(); ++i) table.rows[cursor[row_group[i]]++] = its[i];
+
+    if (opts.bloom_prefilter) {
+        table.filter.emplace(table.groups.size(), opts.bits_per_key);
+        for (auto const& [k, g] : table.groups) table.filter->insert(k);
+    }
+    return table;
+}
+
+template <class L, class R, class LK, class RK>
+using join_key_t = std::common_type_t<std::decay_t<std::invoke_result_t<LK&, std::ranges::range_reference_t<L>>>,
+                                      std::decay_t<std::invoke_result_t<RK&, std::ranges::range_reference_t<R>>>>;
+
+} // namespace detail
+
+// Lazy inner hash join. The smaller side (when both are sized and the left side
+// is a forward range) becomes the build side; the other side is streamed and
+// each probe row yields std::pair<left_reference, right_reference> once per
+// matching build row.
+template <std::ranges::view LV, std::ranges::view RV, class LK, class RK>
+    requires std::ranges::input_range<LV> && std::ranges::forward_range<RV>
+class join_view : public std::ranges::view_interface<join_view<LV, RV, LK, RK>> {
+    using K = detail::join_key_t<LV, RV, LK, RK>;
+    using LRef = std::ranges::range_reference_t<LV>;
+    using RRef = std::ranges::range_reference_t<RV>;
+
+    static constexpr bool can_build_left =
+        std::ranges::forward_range<LV> && std::ranges::sized_range<LV> && std::ranges::sized_range<RV>;
+
+    struct state {
+        LV left;
+        RV right;
+        LK left_key;
+        RK right_key;
+        bool build_left = false;
+        std::optional<detail::join_table<K, std::ranges::iterator_t<LV>>> left_table{};
+        std::optional<detail::join_table<K, std::ranges::iterator_t<RV>>> right_table{};
+    };
+
+public:
+    class iterator {
+    public:
+        using iterator_concept = std::input_iterator_tag;
+        using difference_type  = std::ptrdiff_t;
+        using value_type       = std::pair<LRef, RRef>;
+
+        iterator() = default;
+
+        auto operator*() const -> std::pair<LRef, RRef> {
+            if constexpr (can_build_left) {
+                if (st_->build_left) return {*st_->left_table->rows[pos_], **right_};
+            }
+            return {**left_, *st_->right_table->rows[pos_]};
+        }
+
+        auto operator++() -> iterator& {
+            if (++pos_ == end_) {
+                advance_probe();
+                settle();
+            }
+            return *this;
+        }
+
+        void operator++(int) { ++*this; }
+
+        friend auto operator==(iterator const& it, std::default_sentinel_t) -> bool { return it.at_end(); }
+
+    private:
+        friend class join_view;
+
+        explicit iterator(state* st) : st_(st) {
+            if (probe_left()) left_.emplace(std::ranges::begin(st_->left));
+            else right_.emplace(std::ranges::begin(st_->right));
+            settle();
+        }
+
+        auto probe_left() const -> bool {
+            if constexpr (can_build_left) return !st_->build_left;
+            else return true;
+        }
+
+        auto at_end() const -> bool {
+            if (probe_left()) return *left_ == std::ranges::end(st_->left);
+            return *right_ == std::ranges::end(st_->right);
+        }
+
+        void advance_probe() {
+            if (probe_left()) ++*left_;
+            else ++*right_;
+        }
+
+        void settle() {
+            while (!at_end()) {
+                if (probe_left()) {
+                    std::tie(pos_, end_) = st_->right_table->span_of(K(st_->left_key(**left_)));
+                } else if constexpr (can_build_left) {
+                    std::tie(pos_, end_) = st_->left_table->span_of(K(st_->right_key(**right_)));
+                }
+                if (pos_ != end_) return;
+                advance_probe();
+            }
+        }
+
+        state* st_ = nullptr;
+        std::optional<std::ranges::iterator_t<LV>> left_;
+        std::optional<std::ranges::iterator_t<RV>> right_;
+        std::uint32_t pos_ = 0;
+        std::uint32_t end_ = 0;
+    };
+
+    join_view() = default;
+
+    join_view(LV left, RV right, LK left_key, RK right_key, join_options opts = {})
+        : st_(std::make_shared<state>(state{std::move(left), std::move(right), std::move(left_key), std::move(right_key)})) {
+        if constexpr (can_build_left) {
+            st_->build_left = std::ranges::size(st_->left) < std::ranges::size(st_->right);
+        }
+        if (st_->build_left) {
+            if constexpr (can_build_left) st_->left_table.emplace(detail::build_join_table<K>(st_->left, st_->left_key, opts));
+        } else {
+            st_->right_table.emplace(detail::build_join_table<K>(st_->right, st_->right_key, opts));
+        }
+    }
+
+    auto begin() -> iterator { return iterator{st_.get()}; }
+    auto end() const -> std::default_sentinel_t { return std::default_sentinel; }
+
+    // True when the left side was chosen as the build side.
+    auto builds_left() const -> bool { return st_->build_left; }
+
+private:
+    std::shared_ptr<state> st_;
+};
+
+template <std::ranges::viewable_range L, std::ranges::viewable_range R, class LK, class RK>
+auto join_by(L&& left, R&& right, LK left_key, RK right_key, join_mode::inner_t = join_mode::inner,
+             join_options opts = {}) {
+    using LV = std::views::all_t<L>;
+    using RV = std::views::all_t<R>;
+    return join_view<LV, RV, LK, RK>(std::views::all(std::forward<L>(left)), std::views::all(std::forward<R>(right)),
+                                     std::move(left_key), std::move(right_key), opts);
+}
+
+namespace detail {
+
+template <bool Keep, class L, class R, class LK, class RK>
+auto filter_join(L&& left, R&& right, LK left_key, RK right_key, join_options const& opts) {
+    using K = join_key_t<L, R, LK, RK>;
+    struct key_set {
+        std::unordered_set<K> keys;
+        std::optional<blocked_bloom<K>> filter;
+
+        auto contains(K const& k) const -> bool {
+            if (filter && !filter->may_contain(k)) return false;
+            return keys.contains(k);
+        }
+    };
+
+    auto set = std::make_shared<key_set>();
+    try_reserve(set->keys, size_hint(right, 0));
+    for (auto&& x : right) set->keys.insert(K(right_key(x)));
+    if (opts.bloom_prefilter) {
+        set->filter.emplace(set->keys.size(), opts.bits_per_key);
+        for (auto const& k : set->keys) set->filter->insert(k);
+    }
+    return std::views::all(std::forward<L>(left))
+         | std::views::filter([set = std::move(set), left_key = std::move(left_key)](auto const& x) {
+               return set->contains(K(left_key(x))) == Keep;
+           });
+}
+
+} // namespace detail
+
+// Left rows with at least one match on the right, each emitted once.
+template <std::ranges::viewable_range L, std::ranges::input_range R, class LK, class RK>
+auto join_by(L&& left, R&& right, LK left_key, RK right_key, join_mode::left_semi_t, join_options opts = {}) {
+    return detail::filter_join<true>(std::forward<L>(left), right, std::move(left_key), std::move(right_key), opts);
+}
+
+// Left rows without any match on the right.
+template <std::ranges::viewable_range L, std::ranges::input_range R, class LK, class RK>
+auto join_by(L&& left, R&& right, LK left_key, RK right_key, join_mode::left_anti_t, join_options opts = {}) {
+    return detail::filter_join<false>(std::forward<L>(left), right, std::move(left_key), std::move(right_key), opts);
+}
+
+// ---- pipeline adaptors -------------------------------------------------
+
+namespace adaptors {
+
+template <class KeyProj>
+auto count(KeyProj key, std::size_t expected_unique = 0) {
+    return detail::pipeable{[key = std::move(key), expected_unique](auto&& range) {
+        return count_by(std::forward<decltype(range)>(range), key, expected_unique);
+    }};
+}
+
+template <class KeyProj, class ValProj = std::identity>
+auto group(KeyProj key, ValProj value = {}, std::size_t expected_unique = 0) {
+    return detail::pipeable{[key = std::move(key), value = std::move(value), expected_unique](auto&& range) {
+        return group_by(std::forward<decltype(range)>(range), key, value, expected_unique);
     }};
 }
 
@@ -428,6 +4372,34 @@ auto partition(Pred pred, ValProj value = {}) {
     }};
 }
 
+template <class ChunkFn, class MergeFn>
+auto chunked(ChunkFn chunk_fn, MergeFn merge, chunk_options opts = {}) {
+    return detail::pipeable{[chunk_fn = std::move(chunk_fn), merge = std::move(merge), opts](auto&& range) {
+        return chunked_reduce(std::forward<decltype(range)>(range), chunk_fn, merge, opts);
+    }};
+}
+
+template <executor Executor, class ChunkFn, class MergeFn>
+auto chunked(Executor& ex, ChunkFn chunk_fn, MergeFn merge, chunk_options opts = {}) {
+    return detail::pipeable{[ex = &ex, chunk_fn = std::move(chunk_fn), merge = std::move(merge), opts](auto&& range) {
+        return chunked_reduce(*ex, std::forward<decltype(range)>(range), chunk_fn, merge, opts);
+    }};
+}
+
+template <class KeyProj>
+auto distinct(KeyProj key) {
+    return detail::pipeable{[key = std::move(key)](auto&& range) {
+        return distinct_by(std::forward<decltype(range)>(range), key);
+    }};
+}
+
+template <class KeyProj, class ValProj = std::identity>
+auto dedup(KeyProj key, ValProj value = {}, std::size_t expected_unique = 0) {
+    return detail::pipeable{[key = std::move(key), value = std::move(value), expected_unique](auto&& range) {
+        return dedup_by(std::forward<decltype(range)>(range), key, value, expected_unique);
+    }};
+}
+
 } // namespace adaptors
 
 } // namespace bykey
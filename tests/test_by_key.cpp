@@ -5,6 +5,8 @@
 #include <algorithm>
 #include <unordered_map>
 #include <map>
+#include <coroutine>
+#include <thread>
 #include "by-key/by_key.hpp"
 
 TEST(ByKey, CountByIntegers) {
@@ -261,6 +263,1125 @@ TEST(ByKey, PartitionByEvaluatesPredicateBeforeMove) {
     EXPECT_EQ(partitions.falses, (std::vector<std::string>{"on", "a"}));
 }
 
+TEST(ByKey, ConcurrentAggregatorShardsWriters) {
+    struct AvgTraits {
+        struct state { long sum = 0; int count = 0; };
+        auto identity() const { return state{}; }
+        void combine(state& s, int v) const { s.sum += v; ++s.count; }
+        double finalize(state const& s) const { return s.count ? static_cast<double>(s.sum) / s.count : 0.0; }
+    };
+
+    bykey::concurrent_aggregator<int, AvgTraits> averages(AvgTraits{}, 6);
+    bykey::concurrent_grouper<int, int> groups;
+    EXPECT_EQ(averages.shard_count(), 8u);
+
+    std::vector<std::thread> writers;
+    for (int t = 0; t < 4; ++t) {
+        writers.emplace_back([&, t] {
+            for (int i = 0; i < 1000; ++i) {
+                averages.add(i % 10, t * 1000 + i);
+                groups.add(i % 10, i);
+            }
+        });
+    }
+    for (auto& w : writers) w.join();
+
+    auto live = averages.snapshot();
+    EXPECT_EQ(live.size(), 10u);
+    EXPECT_DOUBLE_EQ(live.at(3), 1500.0 + 498.0);
+
+    auto buckets = std::move(groups).snapshot();
+    ASSERT_EQ(buckets.size(), 10u);
+    EXPECT_EQ(buckets.at(7).size(), 400u);
+
+    bykey::concurrent_grouper<int, std::string> by_length;
+    std::vector<std::string> words{"a", "bb", "cc", "d"};
+    by_length.add_range(words, [](const std::string& s){ return static_cast<int>(s.size()); });
+    auto lengths = std::move(by_length).snapshot();
+    EXPECT_EQ(lengths.at(2), (std::vector<std::string>{"bb", "cc"}));
+}
+
+TEST(ByKey, LocalCombinerFlushesIntoGlobal) {
+    struct SumTraits {
+        auto identity() const { return 0L; }
+        void combine(long& acc, int v) const { acc += v; }
+        void merge(long& into, long&& from) const { into += from; }
+    };
+
+    using Global = bykey::concurrent_aggregator<int, SumTraits>;
+    Global totals;
+
+    std::vector<std::thread> writers;
+    for (int t = 0; t < 4; ++t) {
+        writers.emplace_back([&] {
+            bykey::local_combiner<Global> local(totals, 4);
+            for (int i = 0; i < 10000; ++i) {
+                local.add(i % 3 == 0 ? 0 : i % 16, 1);
+                if (i % 2500 == 0) local.flush();
+            }
+        });
+    }
+    for (auto& w : writers) w.join();
+
+    auto counts = std::move(totals).snapshot();
+    long total = 0;
+    for (auto const& [k, c] : counts) total += c;
+    EXPECT_EQ(total, 40000);
+    EXPECT_EQ(counts.size(), 16u);
+
+    bykey::concurrent_grouper<char, int> groups;
+    {
+        bykey::local_combiner<bykey::concurrent_grouper<char, int>> local(groups, 1);
+        local.add('a', 1);
+        local.add('a', 2);
+        local.add('b', 3);
+        local.add('a', 4);
+        EXPECT_EQ(local.evictions(), 2u);
+    }
+    auto buckets = std::move(groups).snapshot();
+    EXPECT_EQ(buckets.at('a'), (std::vector<int>{1, 2, 4}));
+    EXPECT_EQ(buckets.at('b'), (std::vector<int>{3}));
+}
+
+TEST(ByKey, LocalCombinerUsesAggregatorKeyEqualAndSurvivesMergeErrors) {
+    struct LastDigitHash {
+        auto operator()(int k) const { return std::hash<int>{}(k % 10); }
+    };
+    struct LastDigitEqual {
+        auto operator()(int a, int b) const { return a % 10 == b % 10; }
+    };
+    struct SumTraits {
+        auto identity() const { return 0L; }
+        void combine(long& acc, int v) const { acc += v; }
+        void merge(long& into, long&& from) const { into += from; }
+    };
+
+    using Digits = bykey::concurrent_aggregator<int, SumTraits, LastDigitHash, LastDigitEqual>;
+    Digits digits;
+    {
+        bykey::local_combiner<Digits> local(digits, 1);
+        local.add(1, 1);
+        local.add(11, 2);
+        local.add(21, 3);
+        EXPECT_EQ(local.evictions(), 0u);
+    }
+    EXPECT_EQ(std::move(digits).snapshot().at(1), 6);
+
+    // Stateful hash and equality are kept by the aggregator and its combiners.
+    struct ModHash {
+        int mod;
+        auto operator()(int k) const { return std::hash<int>{}(k % mod); }
+    };
+    struct ModEqual {
+        int mod;
+        auto operator()(int a, int b) const { return a % mod == b % mod; }
+    };
+    using Mod = bykey::concurrent_aggregator<int, SumTraits, ModHash, ModEqual>;
+    Mod by_mod(SumTraits{}, 4, ModHash{5}, ModEqual{5});
+    EXPECT_EQ(by_mod.key_eq().mod, 5);
+    {
+        bykey::local_combiner<Mod> local(by_mod, 1);
+        local.add(2, 1);
+        local.add(7, 2);
+        EXPECT_EQ(local.evictions(), 0u);
+    }
+    by_mod.add(12, 4);
+    auto mod_sums = std::move(by_mod).snapshot();
+    EXPECT_EQ(mod_sums.size(), 1u);
+    EXPECT_EQ(mod_sums.at(17), 7);
+
+    struct ThrowingMerge {
+        auto identity() const { return 0; }
+        void combine(int& acc, int v) const { acc += v; }
+        void merge(int&, int&&) const { throw std::runtime_error("merge"); }
+    };
+    bykey::concurrent_aggregator<int, ThrowingMerge> failing;
+    failing.merge(1, 1);
+    using FailingCombiner = bykey::local_combiner<bykey::concurrent_aggregator<int, ThrowingMerge>>;
+    EXPECT_NO_THROW({
+        FailingCombiner local(failing, 1);
+        local.add(1, 1);
+    });
+}
+
+TEST(ByKey, LiveAggregatorPublishesLayeredSnapshots) {
+    struct CountTraits {
+        auto identity() const { return std::size_t{0}; }
+        void combine(std::size_t& c, int) const { ++c; }
+    };
+
+    bykey::live_aggregator<std::string, CountTraits> live(CountTraits{}, 3);
+    auto empty = live.snapshot();
+    EXPECT_EQ(empty.size(), 0u);
+
+    live.add("a", 1);
+    live.add("b", 1);
+    live.publish();
+    auto first = live.snapshot();
+
+    live.add("a", 1);
+    live.add("c", 1);
+    EXPECT_EQ(live.publish(), 2u);
+    auto second = live.snapshot();
+
+    EXPECT_EQ(first.at("a"), 1u);
+    EXPECT_FALSE(first.contains("c"));
+    EXPECT_EQ(second.at("a"), 2u);
+    EXPECT_EQ(second.at("b"), 1u);
+    EXPECT_EQ(second.size(), 3u);
+    EXPECT_THROW(second.at("z"), std::out_of_range);
+
+    live.add("b", 1);
+    live.publish(); // third layer triggers a flatten
+    auto flat = live.snapshot().to_map();
+    EXPECT_EQ(flat.at("a"), 2u);
+    EXPECT_EQ(flat.at("b"), 2u);
+    EXPECT_EQ(flat.at("c"), 1u);
+
+    std::thread writer([&] {
+        for (int i = 0; i < 5000; ++i) {
+            live.add(std::to_string(i % 7), i);
+            if (i % 500 == 0) live.publish();
+        }
+        live.publish();
+    });
+    std::size_t last_seen = 0;
+    for (int i = 0; i < 200; ++i) {
+        auto snap = live.snapshot();
+        EXPECT_GE(snap.version(), last_seen);
+        last_seen = snap.version();
+    }
+    writer.join();
+    EXPECT_EQ(live.snapshot().at("0"), 715u);
+}
+
+TEST(ByKey, ChunkedReduceOverInputRanges) {
+    auto numbers = std::views::iota(0, 10000)
+                 | std::views::transform([](int x){ return x * 7 % 1000; });
+    bykey::chunk_options opts{.chunk_size = 128, .workers = 3};
+
+    auto counts = bykey::chunked_reduce(
+        numbers,
+        [](auto& chunk){ return bykey::count_by(chunk, [](int x){ return x % 5; }); },
+        bykey::mergers::sum,
+        opts);
+    EXPECT_EQ(counts, bykey::count_by(numbers, [](int x){ return x % 5; }));
+
+    std::vector<std::vector<int>> shards{{1, 2, 3}, {}, {4, 5}, {6, 7, 8, 9}};
+    auto groups = shards | std::views::join | bykey::adaptors::chunked(
+        [](auto& chunk){ return bykey::group_by(chunk, [](int x){ return x % 2; }); },
+        bykey::mergers::append,
+        bykey::chunk_options{.chunk_size = 2, .workers = 2});
+    auto evens = groups.at(0);
+    std::ranges::sort(evens);
+    EXPECT_EQ(evens, (std::vector<int>{2, 4, 6, 8}));
+    EXPECT_EQ(groups.at(1).size(), 5u);
+
+    auto extremes = bykey::chunked_reduce(
+        numbers,
+        [](auto& chunk){ return bykey::minmax_by(chunk, [](int x){ return x % 3; }, [](int x){ return x; }); },
+        bykey::mergers::extrema(),
+        opts);
+    EXPECT_EQ(extremes.at(0).min, 0);
+    EXPECT_EQ(extremes.at(0).max, 999);
+
+    auto parts = bykey::chunked_reduce(
+        std::vector<int>{},
+        [](auto& chunk){ return bykey::partition_by(chunk, [](int x){ return x > 0; }); },
+        bykey::mergers::append);
+    EXPECT_TRUE(parts.trues.empty());
+
+    EXPECT_THROW(
+        bykey::chunked_reduce(
+            numbers,
+            [](auto& chunk) -> std::size_t {
+                if (chunk.front() == 0) throw std::runtime_error("bad chunk");
+                return chunk.size();
+            },
+            [](std::size_t& a, std::size_t&& b){ a += b; },
+            opts),
+        std::runtime_error);
+
+    // A failing worker must stop the producer even when the source never ends.
+    EXPECT_THROW(
+        bykey::chunked_reduce(
+            std::views::iota(0),
+            [](auto& chunk) -> std::size_t {
+                if (chunk.front() >= 1024) throw std::runtime_error("bad chunk");
+                return chunk.size();
+            },
+            [](std::size_t& a, std::size_t&& b){ a += b; },
+            opts),
+        std::runtime_error);
+}
+
+TEST(ByKey, ExecutorsDriveParallelAlgorithms) {
+    bykey::thread_pool pool(2);
+    EXPECT_EQ(pool.size(), 2u);
+
+    std::vector<int> values(5000);
+    for (int i = 0; i < 5000; ++i) values[i] = i;
+
+    auto sums = bykey::chunked_reduce(
+        pool,
+        values | std::views::filter([](int x){ return x % 2 == 0; }),
+        [](auto& chunk){ return bykey::accumulate_by(chunk, [](int x){ return x % 4; }, [](int x){ return x; }); },
+        bykey::mergers::sum,
+        bykey::chunk_options{.chunk_size = 100});
+    EXPECT_EQ(sums.at(0) + sums.at(2), 2 * 2499 * 2500 / 2);
+
+    std::size_t submitted = 0;
+    auto forwarding = bykey::make_executor([&](std::function<void()> task) {
+        ++submitted;
+        pool.execute(std::move(task));
+    });
+    static_assert(bykey::executor<decltype(forwarding)>);
+
+    auto counts = values | bykey::adaptors::chunked(
+        forwarding,
+        [](auto& chunk){ return bykey::count_by(chunk, [](int x){ return x % 3; }); },
+        bykey::mergers::sum,
+        bykey::chunk_options{.chunk_size = 64, .workers = 3});
+    EXPECT_EQ(submitted, 3u);
+    EXPECT_EQ(counts.at(0), 1667u);
+}
+
+TEST(ByKey, RefusingExecutorReportsInsteadOfHanging) {
+    std::vector<int> values(100000);
+    for (int i = 0; i < 100000; ++i) values[i] = i;
+    auto refusing = bykey::make_executor([](std::function<void()>) {
+        throw std::runtime_error("executor refused");
+    });
+
+    EXPECT_THROW(
+        bykey::chunked_reduce(
+            refusing,
+            values,
+            [](auto& chunk){ return bykey::count_by(chunk, [](int x){ return x % 3; }); },
+            bykey::mergers::sum,
+            bykey::chunk_options{.chunk_size = 16, .workers = 2}),
+        std::runtime_error);
+
+    // The second submission is refused after the first one was accepted.
+    bykey::thread_pool pool(2);
+    int accepted = 0;
+    auto flaky = bykey::make_executor([&](std::function<void()> task) {
+        if (accepted++) throw std::runtime_error("executor refused");
+        pool.execute(std::move(task));
+    });
+    std::vector<long> keys(5000);
+    for (std::size_t i = 0; i < keys.size(); ++i) keys[i] = static_cast<long>(i % 97);
+    EXPECT_THROW(bykey::dense_rank_by(flaky, keys, [](long x){ return x; }, std::ranges::less{}, 4),
+                 std::runtime_error);
+}
+
+TEST(ByKey, NestedExecutorAlgorithmsDoNotDeadlock) {
+    bykey::thread_pool pool(2);
+    std::vector<int> values(8 * 4096);
+    for (std::size_t i = 0; i < values.size(); ++i) values[i] = static_cast<int>(i % 1000);
+
+    // Every pool thread drains chunks and waits on a nested parallel sort.
+    auto distinct = bykey::chunked_reduce(
+        pool,
+        values,
+        [&](auto& chunk) -> std::size_t {
+            auto ranks = bykey::dense_rank_by(pool, chunk, [](int x){ return x; }, std::ranges::less{}, 4);
+            return *std::ranges::max_element(ranks);
+        },
+        [](std::size_t& a, std::size_t&& b){ a = std::max(a, b); },
+        bykey::chunk_options{.chunk_size = 4096, .workers = 2});
+    EXPECT_EQ(distinct, 1000u);
+}
+
+namespace {
+
+// Stand-in for an I/O completion: the producer parks here until the test
+// resumes it, the way a reactor would when data arrives.
+struct pending_read {
+    std::coroutine_handle<>* parked;
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> h) noexcept { *parked = h; }
+    void await_resume() const noexcept {}
+};
+
+struct detached_task {
+    struct promise_type {
+        detached_task get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+bykey::async_generator<std::vector<int>> read_batches(std::coroutine_handle<>* parked) {
+    for (int batch = 0; batch < 3; ++batch) {
+        co_await pending_read{parked};
+        std::vector<int> items(4);
+        for (int i = 0; i < 4; ++i) items[i] = batch + i;
+        co_yield items;
+    }
+}
+
+bykey::async_generator<std::string> read_words() {
+    std::vector<std::string> words{"red", "blue", "red", "green"};
+    for (auto& w : words) co_yield w;
+}
+
+detached_task collect_counts(bykey::async_generator<std::unordered_map<int, std::size_t>> counts,
+                             std::vector<std::unordered_map<int, std::size_t>>& out) {
+    while (auto snapshot = co_await counts.next()) out.push_back(std::move(*snapshot));
+}
+
+detached_task collect_lengths(bykey::async_generator<std::unordered_map<std::string, std::size_t>> totals,
+                              std::unordered_map<std::string, std::size_t>& out) {
+    while (auto snapshot = co_await totals.next()) out = std::move(*snapshot);
+}
+
+} // namespace
+
+TEST(ByKey, AsyncAggregationOverCoroutineSources) {
+    std::coroutine_handle<> parked;
+    std::vector<std::unordered_map<int, std::size_t>> snapshots;
+    collect_counts(bykey::async_count_by(read_batches(&parked), [](int x){ return x % 2; }, 6), snapshots);
+
+    int resumes = 0;
+    while (parked) {
+        EXPECT_TRUE(snapshots.size() <= static_cast<std::size_t>(resumes));
+        std::exchange(parked, {}).resume();
+        ++resumes;
+    }
+    EXPECT_EQ(resumes, 3);
+    // The snapshot after the last batch is the final table; it is not repeated.
+    ASSERT_EQ(snapshots.size(), 2u);
+    EXPECT_EQ(snapshots[0].at(0) + snapshots[0].at(1), 8u);
+    EXPECT_EQ(snapshots.back().at(0), 6u);
+    EXPECT_EQ(snapshots.back().at(1), 6u);
+
+    snapshots.clear();
+    collect_counts(bykey::async_count_by(read_batches(&parked), [](int x){ return x % 2; }, 5), snapshots);
+    while (parked) std::exchange(parked, {}).resume();
+    ASSERT_EQ(snapshots.size(), 2u);
+    EXPECT_EQ(snapshots.back().at(0) + snapshots.back().at(1), 12u);
+
+    std::unordered_map<std::string, std::size_t> lengths;
+    collect_lengths(
+        bykey::async_transform_reduce_by(
+            read_words(),
+            [](const std::string& w){ return w; },
+            [](const std::string& w){ return w.size(); },
+            std::size_t{0},
+            std::plus<>{}),
+        lengths);
+    EXPECT_EQ(lengths.at("red"), 6u);
+    EXPECT_EQ(lengths.at("green"), 5u);
+}
+
+TEST(ByKey, AggregationPipelineDrainsSpscRing) {
+    bykey::spsc_ring<int> ring(3);
+    EXPECT_EQ(ring.capacity(), 4u);
+    for (int i = 0; i < 4; ++i) EXPECT_TRUE(ring.try_push(i));
+    EXPECT_FALSE(ring.try_push(4));
+    std::vector<int> drained;
+    EXPECT_EQ(ring.pop_batch([&](int&& x){ drained.push_back(x); }, 3), 3u);
+    EXPECT_EQ(ring.size(), 1u);
+    EXPECT_EQ(drained, (std::vector<int>{0, 1, 2}));
+
+    struct Event { std::string user; int bytes; };
+    struct SumTraits {
+        auto identity() const { return 0L; }
+        void combine(long& acc, int v) const { acc += v; }
+    };
+    std::atomic<bool> started{false};
+    auto totals = bykey::make_aggregation_pipeline<Event>(
+        [](const Event& e){ return e.user; },
+        [](const Event& e){ return e.bytes; },
+        SumTraits{},
+        bykey::pipeline_options{.capacity = 64, .batch_size = 16, .on_start = [&]{ started = true; }});
+    auto counts = bykey::make_count_pipeline<int>([](int x){ return x % 4; },
+                                                  bykey::pipeline_options{.capacity = 8});
+
+    std::thread parser([&] {
+        for (int i = 0; i < 20000; ++i) {
+            totals->push(Event{i % 2 ? "odd" : "even", 1});
+            counts->push(i);
+        }
+    });
+    parser.join();
+
+    auto sums = totals->finish();
+    EXPECT_TRUE(started);
+    EXPECT_EQ(sums.at("odd"), 10000);
+    EXPECT_EQ(sums.at("even"), 10000);
+    auto stats = totals->stats();
+    EXPECT_EQ(stats.pushed, 20000u);
+    EXPECT_GE(stats.batches, 20000u / 16);
+    EXPECT_LE(stats.max_depth, 64u);
+
+    auto freq = counts->finish();
+    EXPECT_EQ(freq.at(3), 5000u);
+    EXPECT_EQ(counts->depth(), 0u);
+    EXPECT_EQ(counts->finish(), freq);
+    EXPECT_THROW(counts->push(1), std::runtime_error);
+
+    // The aggregator thread is held in on_start, so the ring stays full.
+    std::atomic<bool> release{false};
+    auto words = bykey::make_count_pipeline<std::string>(
+        [](const std::string& w){ return w; },
+        bykey::pipeline_options{.capacity = 2, .on_start = [&]{ while (!release) std::this_thread::yield(); }});
+    EXPECT_TRUE(words->try_push(std::string("a")));
+    EXPECT_TRUE(words->try_push(std::string("b")));
+    std::string rejected = "c";
+    EXPECT_FALSE(words->try_push(std::move(rejected)));
+    EXPECT_EQ(rejected, "c");
+    release = true;
+    while (!words->try_push(std::move(rejected))) std::this_thread::yield();
+    EXPECT_EQ(words->finish().at("c"), 1u);
+
+    // A throwing projection stops the aggregator thread and surfaces here.
+    auto failing = bykey::make_count_pipeline<int>(
+        [](int x) { if (x == 3) throw std::runtime_error("bad record"); return x; },
+        bykey::pipeline_options{.capacity = 4});
+    EXPECT_THROW({
+        for (int i = 0; i < 1000; ++i) failing->push(i);
+    }, std::runtime_error);
+    EXPECT_THROW(failing->finish(), std::runtime_error);
+    EXPECT_THROW(failing->push(0), std::runtime_error);
+}
+
+TEST(ByKey, JoinByModes) {
+    struct User { int id; std::string name; };
+    struct Order { int user; int amount; };
+    std::vector<User> users{{1, "ann"}, {2, "bob"}, {3, "cyd"}};
+    std::vector<Order> orders{{1, 10}, {3, 5}, {1, 7}, {4, 1}, {3, 2}, {1, 1}};
+
+    auto joined = bykey::join_by(users, orders,
+                                 [](const User& u){ return u.id; },
+                                 [](const Order& o){ return o.user; });
+    EXPECT_TRUE(joined.builds_left());
+    std::map<std::string, int> spent;
+    std::size_t matches = 0;
+    for (auto [user, order] : joined) {
+        spent[user.name] += order.amount;
+        ++matches;
+    }
+    EXPECT_EQ(matches, 5u);
+    EXPECT_EQ(spent, (std::map<std::string, int>{{"ann", 18}, {"cyd", 7}}));
+
+    auto streamed = bykey::join_by(orders | std::views::filter([](const Order& o){ return o.amount > 1; }),
+                                   users,
+                                   [](const Order& o){ return o.user; },
+                                   [](const User& u){ return u.id; });
+    std::vector<std::string> names;
+    for (auto [order, user] : streamed) names.push_back(user.name);
+    EXPECT_EQ(names, (std::vector<std::string>{"ann", "cyd", "ann", "cyd"}));
+
+    auto semi = bykey::join_by(orders, users,
+                               [](const Order& o){ return o.user; },
+                               [](const User& u){ return u.id; },
+                               bykey::join_mode::left_semi);
+    EXPECT_EQ(std::ranges::distance(semi), 5);
+
+    auto anti = bykey::join_by(users, orders,
+                               [](const User& u){ return u.id; },
+                               [](const Order& o){ return o.user; },
+                               bykey::join_mode::left_anti);
+    std::vector<int> lonely;
+    for (auto const& u : anti) lonely.push_back(u.id);
+    EXPECT_EQ(lonely, (std::vector<int>{2}));
+
+    std::vector<int> none;
+    auto empty = bykey::join_by(none, users, [](int x){ return x; }, [](const User& u){ return u.id; });
+    EXPECT_TRUE(empty.begin() == empty.end());
+}
+
+TEST(ByKey, BloomPrefilterSkipsMisses) {
+    bykey::blocked_bloom<int> bloom(1000);
+    for (int i = 0; i < 1000; ++i) bloom.insert(i * 7);
+    std::size_t false_positives = 0;
+    for (int i = 0; i < 7000; ++i) {
+        if (i % 7 == 0) EXPECT_TRUE(bloom.may_contain(i));
+        else if (bloom.may_contain(i)) ++false_positives;
+    }
+    EXPECT_LT(false_positives, 6000u / 20);
+
+    std::vector<int> watchlist{3, 14, 15, 92, 65};
+    auto index = bykey::make_prefiltered(bykey::index_by(
+        watchlist, [](int x){ return x; }, [i = 0](int) mutable { return i++; }));
+    EXPECT_EQ(index.at(92), 3);
+    EXPECT_FALSE(index.contains(4));
+    EXPECT_EQ(index.find(7), index.end());
+
+    auto counts = bykey::make_prefiltered(bykey::count_by(std::string{"mississippi"}, [](char c){ return c; }));
+    EXPECT_EQ(counts.at('s'), 4u);
+    EXPECT_EQ(counts.count('z'), 0u);
+
+    std::vector<int> events(500);
+    for (int i = 0; i < 500; ++i) events[i] = i;
+    bykey::join_options filtered{.bloom_prefilter = true};
+    auto hits = bykey::join_by(events, watchlist,
+                               [](int x){ return x; }, [](int x){ return x; },
+                               bykey::join_mode::left_semi, filtered);
+    EXPECT_EQ(std::ranges::distance(hits), 5);
+
+    auto pairs = bykey::join_by(events, watchlist,
+                                [](int x){ return x; }, [](int x){ return x; },
+                                bykey::join_mode::inner, filtered);
+    std::vector<int> matched;
+    for (auto [e, w] : pairs) matched.push_back(e);
+    EXPECT_EQ(matched, (std::vector<int>{3, 14, 15, 65, 92}));
+}
+
+TEST(ByKey, MultisetCountsByKey) {
+    std::vector<int> a{1, 2, 2, 1, 5};
+    std::vector<int> b{2, 2, 2, 3};
+    auto id = [](int x){ return x; };
+
+    auto common = bykey::intersect_counts_by(a, b, id);
+    EXPECT_EQ(common.size(), 1u);
+    EXPECT_EQ(common.at(2), 2u);
+    EXPECT_EQ(bykey::intersect_counts_by(b, a, id), common);
+
+    auto a_minus_b = bykey::subtract_counts_by(a, b, id);
+    EXPECT_EQ(a_minus_b.at(1), 2u);
+    EXPECT_EQ(a_minus_b.at(5), 1u);
+    EXPECT_FALSE(a_minus_b.contains(2));
+
+    auto b_minus_a = bykey::subtract_counts_by(b, a, id);
+    EXPECT_EQ(b_minus_a.size(), 2u);
+    EXPECT_EQ(b_minus_a.at(2), 1u);
+    EXPECT_EQ(b_minus_a.at(3), 1u);
+
+    EXPECT_TRUE(bykey::equal_counts_by(std::string{"listen"}, std::string{"silent"}, [](char c){ return c; }));
+    EXPECT_FALSE(bykey::equal_counts_by(std::string{"abc"}, std::string{"abcd"}, [](char c){ return c; }));
+
+    std::size_t pulled = 0;
+    auto stream = std::views::iota(0, 1000)
+                | std::views::filter([](int){ return true; }) // unsized: no length shortcut
+                | std::views::transform([&](int x){ ++pulled; return x; });
+    EXPECT_FALSE(bykey::equal_counts_by(std::vector<int>{5, 6, 7}, stream, id));
+    EXPECT_EQ(pulled, 1u);
+}
+
+TEST(ByKey, DistinctAndDedupKeepFirstSeen) {
+    struct Row { std::string user; int ts; };
+    std::vector<Row> rows{{"ann", 1}, {"bob", 2}, {"ann", 3}, {"cyd", 4}, {"bob", 5}};
+
+    std::vector<int> first_ts;
+    for (auto const& r : bykey::distinct_by(rows, [](const Row& r){ return r.user; })) first_ts.push_back(r.ts);
+    EXPECT_EQ(first_ts, (std::vector<int>{1, 2, 4}));
+
+    auto lazy = std::views::iota(0, 100) | bykey::adaptors::distinct([](int x){ return x % 7; });
+    EXPECT_EQ(std::ranges::distance(lazy), 7);
+    EXPECT_EQ(std::ranges::distance(lazy), 7); // a second pass starts over
+
+    // A copy keeps its own seen-set, so iterating it leaves a live pass intact.
+    int offset = 0;
+    auto tagged = std::views::iota(0, 20) | bykey::adaptors::distinct([offset](int x){ return (x + offset) % 4; });
+    auto it = tagged.begin();
+    ++it;
+    auto copy = tagged;
+    EXPECT_EQ(std::ranges::distance(copy), 4);
+    std::vector<int> rest;
+    for (; it != tagged.end(); ++it) rest.push_back(*it);
+    EXPECT_EQ(rest, (std::vector<int>{1, 2, 3}));
+    copy = tagged;
+    EXPECT_EQ(std::ranges::distance(copy), 4);
+
+    auto users = bykey::dedup_by(rows, [](const Row& r){ return r.user; }, [](const Row& r){ return r.user; });
+    EXPECT_EQ(users, (std::vector<std::string>{"ann", "bob", "cyd"}));
+
+    std::vector<int> many(10000);
+    for (int i = 0; i < 10000; ++i) many[i] = (i * 37) % 2500;
+    auto uniq = many | bykey::adaptors::dedup([](int x){ return x; });
+    EXPECT_EQ(uniq.size(), 2500u);
+    EXPECT_EQ(uniq[1], 37);
+}
+
+TEST(ByKey, DenseRankByRadixSortAndParallel) {
+    std::vector<int> values{5, -3, 5, 0, -3, 1000000, -2147483647};
+    auto ranks = bykey::dense_rank_by(values, [](int x){ return x; });
+    EXPECT_EQ(ranks, (std::vector<std::size_t>{4, 2, 4, 3, 2, 5, 1}));
+
+    std::vector<std::string> words{"pear", "apple", "fig", "apple"};
+    auto by_length_desc = bykey::dense_rank_by(words, [](const std::string& w){ return w.size(); }, std::ranges::greater{});
+    EXPECT_EQ(by_length_desc, (std::vector<std::size_t>{2, 1, 3, 1}));
+    auto alphabetical = bykey::dense_rank_by(words, [](const std::string& w){ return w; });
+    EXPECT_EQ(alphabetical, (std::vector<std::size_t>{3, 1, 2, 1}));
+
+    std::vector<long> big(20000);
+    for (std::size_t i = 0; i < big.size(); ++i) big[i] = static_cast<long>((i * 7919) % 5000) - 2500;
+    bykey::thread_pool pool(3);
+    auto parallel = bykey::dense_rank_by(pool, big, [](long x){ return x; });
+    EXPECT_EQ(parallel, bykey::dense_rank_by(big, [](long x){ return x; }));
+    EXPECT_EQ(*std::ranges::max_element(parallel), 5000u);
+}
+
+TEST(ByKey, StrategySelectionPicksEngines) {
+    std::vector<bykey::strategy_report> reports;
+    bykey::strategy_policy logged{.on_select = [&](auto const& r){ reports.push_back(r); }};
+
+    std::vector<int> small_range{3, -1, 3, 7, -1, 3};
+    auto counts = bykey::count_by(logged, small_range, [](int x){ return x; });
+    EXPECT_EQ(counts, bykey::count_by(small_range, [](int x){ return x; }));
+    ASSERT_EQ(reports.size(), 1u);
+    EXPECT_EQ(reports[0].chosen, bykey::engine::dense);
+    EXPECT_EQ(reports[0].key_span, 9u);
+
+    std::vector<std::string> sorted_words{"a", "a", "b", "c", "c", "c"};
+    auto word_counts = bykey::count_by(logged, sorted_words, [](const std::string& s){ return s; });
+    EXPECT_EQ(reports.back().chosen, bykey::engine::sort);
+    EXPECT_EQ(word_counts.at("c"), 3u);
+
+    std::vector<long> sparse{1, 1000000000000L, 5, 1};
+    auto sums = bykey::accumulate_by(logged, sparse, [](long x){ return x; }, [](long){ return 2; });
+    EXPECT_EQ(reports.back().chosen, bykey::engine::hash);
+    EXPECT_EQ(sums.at(1), 4);
+
+    struct Row { int bucket; std::string name; };
+    std::vector<Row> rows{{2, "x"}, {0, "y"}, {2, "z"}};
+    for (auto const* policy : {&bykey::strategy::automatic, &bykey::strategy::hash, &bykey::strategy::sort, &bykey::strategy::dense}) {
+        auto groups = bykey::group_by(*policy, rows, [](const Row& r){ return r.bucket; }, [](const Row& r){ return r.name; });
+        EXPECT_EQ(groups.at(2), (std::vector<std::string>{"x", "z"}));
+        EXPECT_EQ(groups.size(), 2u);
+        auto totals = bykey::accumulate_by(*policy, rows, [](const Row& r){ return r.bucket; }, [](const Row& r){ return r.bucket; });
+        EXPECT_EQ(totals.at(2), 4);
+    }
+
+    auto forced = bykey::count_by(bykey::strategy::dense, sorted_words, [](const std::string& s){ return s; });
+    EXPECT_EQ(forced.at("a"), 2u);
+
+    auto lazy = std::views::iota(0, 50) | std::views::filter([](int x){ return x % 2; });
+    auto odd_counts = bykey::count_by(logged, lazy, [](int x){ return x % 5; });
+    EXPECT_EQ(odd_counts.at(1), 5u);
+
+    // Forced hash/sort read the input once; automatic selection only scans the
+    // whole input for min/max when the prefix sample has a small key span.
+    std::vector<long> wide(5000);
+    for (std::size_t i = 0; i < wide.size(); ++i) wide[i] = static_cast<long>(i) * 1000003L;
+    std::size_t calls = 0;
+    auto counted = [&](long x){ ++calls; return x; };
+    bykey::count_by(bykey::strategy::hash, wide, counted);
+    EXPECT_EQ(calls, wide.size());
+    calls = 0;
+    bykey::count_by(bykey::strategy::sort, wide, counted);
+    EXPECT_EQ(calls, wide.size());
+    calls = 0;
+    bykey::count_by(logged, wide, counted);
+    EXPECT_EQ(reports.back().chosen, bykey::engine::hash);
+    EXPECT_EQ(reports.back().key_span, 0u);
+    EXPECT_EQ(calls, wide.size() + logged.sample_size);
+}
+
+TEST(ByKey, ColumnarAggregationOverSpans) {
+    std::vector<std::uint64_t> keys;
+    std::vector<double> values;
+    for (int i = 0; i < 1000; ++i) {
+        keys.push_back(static_cast<std::uint64_t>(i / 100 % 3));
+        values.push_back(i % 10);
+    }
+
+    auto counts = bykey::count_by_column(keys);
+    EXPECT_EQ(counts.keys, (std::vector<std::uint64_t>{0, 1, 2}));
+    EXPECT_EQ(counts.values, (std::vector<std::size_t>{400, 300, 300}));
+
+    auto sums = bykey::accumulate_by_columns(std::span<const std::uint64_t>(keys), std::span<const double>(values));
+    ASSERT_EQ(sums.keys.size(), 3u);
+    EXPECT_DOUBLE_EQ(sums.values[0], 400 * 4.5);
+    EXPECT_DOUBLE_EQ(sums.values[2], 300 * 4.5);
+
+    std::vector<int> scattered_keys{7, 3, 7, 9, 3};
+    std::vector<int> scattered_vals{5, -2, 11, 0, 4};
+    auto ext = bykey::extrema_by_columns(scattered_keys, scattered_vals);
+    EXPECT_EQ(ext.keys, (std::vector<int>{7, 3, 9}));
+    EXPECT_EQ(ext.min, (std::vector<int>{5, -2, 0}));
+    EXPECT_EQ(ext.max, (std::vector<int>{11, 4, 0}));
+
+    EXPECT_THROW(bykey::accumulate_by_columns(scattered_keys, values), std::invalid_argument);
+}
+
+TEST(ByKey, ColumnarResultPolicy) {
+    std::vector<std::string> words{"pear", "fig", "apple", "fig", "pear", "kiwi", "fig"};
+    auto self = [](std::string const& w) { return w; };
+
+    auto counts = bykey::count_by(bykey::result::columns, words, self);
+    EXPECT_EQ(counts.keys(), (std::vector<std::string>{"pear", "fig", "apple", "kiwi"}));
+    EXPECT_EQ(counts.values(), (std::vector<std::size_t>{2, 3, 1, 1}));
+    EXPECT_EQ(counts.at("fig"), 3u);
+    EXPECT_FALSE(counts.contains("plum"));
+    EXPECT_THROW(counts.at("plum"), std::out_of_range);
+
+    auto lengths = bykey::accumulate_by(bykey::result::sorted_columns, words, self,
+                                        [](std::string const& w) { return w.size(); });
+    EXPECT_EQ(lengths.keys(), (std::vector<std::string>{"apple", "fig", "kiwi", "pear"}));
+    EXPECT_EQ(lengths.values(), (std::vector<std::size_t>{5, 9, 4, 8}));
+    EXPECT_EQ(lengths.find("pear")->second, 8u);
+
+    std::vector<int> xs;
+    for (int i = 0; i < 5000; ++i) xs.push_back(i);
+    auto groups = bykey::group_by(bykey::result::columns, xs, [](int x) { return x % 7; });
+    ASSERT_EQ(groups.size(), 7u);
+    EXPECT_EQ(groups.keys().front(), 0);
+    EXPECT_EQ(groups[3].front(), 3);
+    // The row-count size hint only sizes the index; columns grow with the keys.
+    EXPECT_LT(groups.keys().capacity(), xs.size());
+
+    struct AvgTraits {
+        struct state { double sum = 0.0; int count = 0; };
+
+        auto identity() const { return state{}; }
+
+        void combine(state& s, int value) const {
+            s.sum += value;
+            ++s.count;
+        }
+
+        double finalize(state const& s) const { return s.sum / s.count; }
+    };
+
+    auto means = bykey::transform_reduce_by(bykey::result::sorted_columns, xs, [](int x) { return x % 3; },
+                                            std::identity{}, AvgTraits{});
+    EXPECT_EQ(means.keys(), (std::vector<int>{0, 1, 2}));
+    EXPECT_DOUBLE_EQ(means.values()[0], 2499.0);
+
+    auto ext = bykey::extrema_by(bykey::result::columns, xs, [](int x) { return x % 2; }, std::identity{});
+    EXPECT_EQ(ext.values()[1].max, 4999);
+
+    auto exported = std::move(counts).release();
+    EXPECT_EQ(exported.keys.size(), exported.values.size());
+}
+
+TEST(ByKey, GroupingReusesKeyIds) {
+    struct Row { std::string region; int latency; };
+    std::vector<Row> rows{{"eu", 30}, {"us", 12}, {"eu", 18}, {"ap", 44}, {"us", 9}, {"eu", 21}};
+
+    bykey::grouping g = bykey::make_grouping(rows, [](Row const& r) { return r.region; });
+    EXPECT_EQ(g.keys(), (std::vector<std::string>{"eu", "us", "ap"}));
+    EXPECT_EQ(g.ids(), (std::vector<std::uint32_t>{0, 1, 0, 2, 1, 0}));
+
+    auto latency = [](Row const& r) { return r.latency; };
+    EXPECT_EQ(g.count(), (std::vector<std::size_t>{3, 2, 1}));
+    EXPECT_EQ(g.sum(latency), (std::vector<int>{69, 21, 44}));
+
+    auto ext = g.extrema(latency);
+    EXPECT_EQ(ext[0].min, 18);
+    EXPECT_EQ(ext[0].max, 30);
+    EXPECT_EQ(ext[1].min, 9);
+
+    auto buckets = g.group(latency);
+    EXPECT_EQ(buckets[1], (std::vector<int>{12, 9}));
+
+    struct AvgTraits {
+        struct state { double sum = 0.0; int count = 0; };
+        auto identity() const { return state{}; }
+        void combine(state& s, int v) const { s.sum += v; ++s.count; }
+        double finalize(state const& s) const { return s.sum / s.count; }
+    };
+    auto means = g.reduce(AvgTraits{}, latency);
+    EXPECT_DOUBLE_EQ(means[0], 23.0);
+    EXPECT_DOUBLE_EQ(means[2], 44.0);
+}
+
+TEST(ByKey, EncodedKeysFeedAggregations) {
+    struct Row { std::string service; int bytes; };
+    std::vector<Row> rows{{"auth", 10}, {"auth", 5}, {"search", 7}, {"billing", 1}, {"search", 3}, {"auth", 2}};
+    std::string long_name(40000, 'x');
+    rows.push_back({long_name, 4});
+
+    auto enc = bykey::encode_keys(rows, [](Row const& r) { return r.service; });
+    EXPECT_EQ(enc.size(), 4u);
+    EXPECT_EQ(enc.rows(), rows.size());
+    EXPECT_EQ(enc.codes(), (std::vector<std::uint32_t>{0, 0, 1, 2, 1, 0, 3}));
+    EXPECT_EQ(enc[4], "search");
+    EXPECT_EQ(enc.keys()[3], long_name);
+    EXPECT_EQ(enc.code_of("billing"), std::optional<std::uint32_t>{2});
+    EXPECT_FALSE(enc.code_of("nope"));
+
+    auto moved = std::move(enc);
+    auto counts = bykey::count_by(moved);
+    EXPECT_EQ(counts.keys, (std::vector<std::string_view>{"auth", "search", "billing", long_name}));
+    EXPECT_EQ(counts.values, (std::vector<std::size_t>{3, 2, 1, 1}));
+
+    std::vector<int> bytes;
+    for (auto const& r : rows) bytes.push_back(r.bytes);
+    auto totals = bykey::accumulate_by(moved, bytes);
+    EXPECT_EQ(totals.values, (std::vector<int>{17, 10, 1, 4}));
+    bytes.pop_back();
+    EXPECT_THROW(bykey::accumulate_by(moved, bytes), std::invalid_argument);
+
+    auto g = bykey::make_grouping(rows, moved);
+    EXPECT_EQ(g.sum([](Row const& r) { return r.bytes; }), (std::vector<int>{17, 10, 1, 4}));
+    EXPECT_EQ(g.keys()[1], "search");
+}
+
+TEST(ByKey, GroupByLevelsPrefixLookups) {
+    struct Hit { std::string region; std::string service; int endpoint; };
+    std::vector<Hit> hits{
+        {"us", "auth", 2}, {"eu", "search", 1}, {"eu", "auth", 1}, {"us", "auth", 1},
+        {"eu", "auth", 1}, {"us", "auth", 2}, {"eu", "search", 3},
+    };
+
+    auto levels = bykey::group_by_levels(
+        hits,
+        [](Hit const& h) { return h.region; },
+        [](Hit const& h) { return h.service; },
+        [](Hit const& h) { return h.endpoint; });
+
+    EXPECT_EQ(levels.depth, 3u);
+    EXPECT_EQ(levels.size(), 5u);
+    EXPECT_EQ(levels.count(), hits.size());
+    EXPECT_EQ(levels.count(std::string("eu")), 4u);
+    EXPECT_EQ(levels.count("eu", "auth"), 2u);
+    EXPECT_EQ(levels.count("us", "auth", 2), 2u);
+    EXPECT_EQ(levels.count("ap"), 0u);
+
+    EXPECT_EQ(levels.children(), (std::vector<std::string>{"eu", "us"}));
+    EXPECT_EQ(levels.children("eu"), (std::vector<std::string>{"auth", "search"}));
+    EXPECT_EQ(levels.children("eu", "search"), (std::vector<int>{1, 3}));
+
+    auto us_auth = levels.values("us", "auth");
+    ASSERT_EQ(us_auth.size(), 3u);
+    EXPECT_EQ(us_auth[0].endpoint, 1);
+    EXPECT_EQ(levels.boundaries(0), (std::vector<std::size_t>{0, 3, 5}));
+    EXPECT_EQ(levels.boundaries(1), (std::vector<std::size_t>{0, 1, 3, 5}));
+}
+
+TEST(ByKey, RollupAndCubeDeriveCoarserSets) {
+    struct Sale { std::string region; std::string product; int amount; };
+    std::vector<Sale> sales{{"eu", "tea", 3}, {"eu", "coffee", 5}, {"us", "tea", 7}, {"eu", "tea", 1}};
+    auto key    = [](Sale const& s) { return std::tuple{s.region, s.product}; };
+    auto amount = [](Sale const& s) { return s.amount; };
+    using Opt = std::optional<std::string>;
+    using Key = std::tuple<Opt, Opt>;
+
+    auto rollup = bykey::rollup_by(sales, key, amount);
+    EXPECT_EQ(rollup.size(), 3u + 2u + 1u);
+    EXPECT_EQ(rollup.at(Key{"eu", "tea"}), 4);
+    EXPECT_EQ(rollup.at(Key{"eu", std::nullopt}), 9);
+    EXPECT_EQ(rollup.at(Key{std::nullopt, std::nullopt}), 16);
+    EXPECT_FALSE(rollup.contains(Key{std::nullopt, "tea"}));
+
+    struct MeanTraits {
+        struct state { int sum = 0; int count = 0; };
+        auto identity() const { return state{}; }
+        void combine(state& s, int v) const { s.sum += v; ++s.count; }
+        void merge(state& into, state&& from) const { into.sum += from.sum; into.count += from.count; }
+        double finalize(state const& s) const { return double(s.sum) / s.count; }
+    };
+    auto cube = bykey::cube_by(sales, key, amount, MeanTraits{});
+    EXPECT_EQ(cube.size(), 3u + 2u + 2u + 1u);
+    EXPECT_DOUBLE_EQ(cube.at(Key{std::nullopt, "tea"}), 11.0 / 3);
+    EXPECT_DOUBLE_EQ(cube.at(Key{"us", std::nullopt}), 7.0);
+    EXPECT_DOUBLE_EQ(cube.at(Key{std::nullopt, std::nullopt}), 4.0);
+}
+
+TEST(ByKey, WindowFunctionsPerKey) {
+    struct Tick { char sym; int px; };
+    std::vector<Tick> ticks{{'a', 1}, {'b', 10}, {'a', 2}, {'a', 3}, {'b', 20}, {'a', 4}};
+    auto sym = [](Tick const& t) { return t.sym; };
+    auto px  = [](Tick const& t) { return t.px; };
+
+    EXPECT_EQ(bykey::scan_by(ticks, sym, px), (std::vector<int>{1, 10, 3, 6, 30, 10}));
+    EXPECT_EQ(bykey::scan_by(ticks, sym, px, [](int a, int b) { return std::max(a, b); }),
+              (std::vector<int>{1, 10, 2, 3, 20, 4}));
+    EXPECT_EQ(bykey::row_number_by(ticks, sym), (std::vector<std::size_t>{1, 1, 2, 3, 2, 4}));
+
+    using O = std::optional<int>;
+    EXPECT_EQ(bykey::lag_by(ticks, sym, px), (std::vector<O>{{}, {}, 1, 2, 10, 3}));
+    EXPECT_EQ(bykey::lag_by(ticks, sym, px, 2), (std::vector<O>{{}, {}, {}, 1, {}, 2}));
+    EXPECT_EQ(bykey::lead_by(ticks, sym, px), (std::vector<O>{2, 20, 3, 4, {}, {}}));
+    EXPECT_EQ(bykey::lead_by(ticks, sym, px, 2), (std::vector<O>{3, {}, 4, {}, {}, {}}));
+}
+
+TEST(ByKey, TopKPerKeyBoundedHeaps) {
+    struct Req { std::string endpoint; int ms; };
+    std::vector<Req> reqs;
+    for (int i = 0; i < 200; ++i) reqs.push_back({i % 2 ? "/a" : "/b", (i * 37) % 101});
+    auto endpoint = [](Req const& r) { return r.endpoint; };
+    auto ms = [](Req const& r) { return r.ms; };
+
+    auto slowest = bykey::top_k_per_key_by(reqs, endpoint, ms, 3);
+    auto expected = bykey::group_by(reqs, endpoint, ms);
+    for (auto& [ep, all] : expected) {
+        std::ranges::sort(all, std::ranges::greater{});
+        all.resize(3);
+        EXPECT_EQ(slowest.at(ep), all) << ep;
+    }
+
+    auto fastest = bykey::top_k_per_key_by(reqs, endpoint, ms, 2, std::ranges::less{});
+    EXPECT_EQ(fastest.at("/b").size(), 2u);
+    EXPECT_LE(fastest.at("/b")[0], fastest.at("/b")[1]);
+
+    bykey::thread_pool pool(3);
+    auto merged = bykey::chunked_reduce(
+        pool, reqs,
+        [&](auto const& chunk) {
+            bykey::top_k_accumulator<std::string, int> acc(3);
+            acc.add_range(chunk, endpoint, ms);
+            return acc;
+        },
+        bykey::mergers::member, {.chunk_size = 16});
+    EXPECT_EQ(merged.to_map(), slowest);
+}
+
+TEST(ByKey, SampleByKeepsBoundedUniformReservoirs) {
+    std::vector<int> xs;
+    for (int i = 0; i < 10000; ++i) xs.push_back(i);
+    auto parity = [](int x) { return x % 2; };
+
+    auto sample = bykey::sample_by(xs, parity, std::identity{}, 5, 42);
+    ASSERT_EQ(sample.size(), 2u);
+    EXPECT_EQ(sample.at(0).size(), 5u);
+    for (int v : sample.at(1)) EXPECT_EQ(v % 2, 1);
+    EXPECT_EQ(sample, bykey::sample_by(xs, parity, std::identity{}, 5, 42));
+
+    auto small = bykey::sample_by(std::vector<int>{1, 2, 3}, parity, std::identity{}, 5);
+    EXPECT_EQ(small.at(1), (std::vector<int>{1, 3}));
+
+    // Each of 4 values should land in a 1-slot merged reservoir about a quarter of the time.
+    std::array<int, 4> hits{};
+    for (std::uint64_t seed = 0; seed < 4000; ++seed) {
+        bykey::reservoir_accumulator<int, int> left(1, seed), right(1, seed + 7919);
+        left.add(0, 0);
+        right.add_range(std::vector<int>{1, 2, 3}, [](int) { return 0; }, std::identity{});
+        left.merge(std::move(right));
+        EXPECT_EQ(left.seen(0), 4u);
+        ++hits[static_cast<std::size_t>(left.values(0)[0])];
+    }
+    for (int h : hits) EXPECT_NEAR(h, 1000, 150);
+}
+
+TEST(ByKey, ParallelSampleByIsDeterministic) {
+    std::vector<int> xs(200000);
+    for (int i = 0; i < 200000; ++i) xs[i] = i;
+    auto bucket = [](int x) { return x % 3; };
+
+    bykey::thread_pool pool(3);
+    auto first = bykey::sample_by(pool, xs, bucket, std::identity{}, 8, 42);
+    ASSERT_EQ(first.size(), 3u);
+    for (auto const& [k, values] : first) {
+        EXPECT_EQ(values.size(), 8u);
+        for (int v : values) EXPECT_EQ(v % 3, k);
+    }
+    EXPECT_EQ(bykey::sample_by(pool, xs, bucket, std::identity{}, 8, 42), first);
+
+    bykey::thread_pool single(1);
+    EXPECT_EQ(bykey::sample_by(single, xs, bucket, std::identity{}, 8, 42), first);
+    EXPECT_NE(bykey::sample_by(pool, xs, bucket, std::identity{}, 8, 43), first);
+
+    // Samples are drawn from every chunk, not just the first one.
+    std::size_t late = 0;
+    for (int seed = 0; seed < 20; ++seed) {
+        auto sample = bykey::sample_by(pool, xs, bucket, std::identity{}, 8, seed);
+        for (int v : sample.at(0)) late += v >= (1 << 16);
+    }
+    EXPECT_GT(late, 20u * 8 / 2);
+}
+
+TEST(ByKey, QuantilesBySelection) {
+    std::vector<int> xs;
+    for (int i = 0; i < 3001; ++i) xs.push_back((i * 7919) % 3001);
+    auto bucket = [](int x) { return x % 3; };
+
+    auto q = bykey::quantiles_by(xs, bucket, std::identity{}, {0.99, 0.5, 0.0, 1.0, 0.5});
+    auto expected = bykey::group_by(xs, bucket);
+    for (auto& [k, values] : expected) {
+        std::ranges::sort(values);
+        auto at = [&](double p) { return values[static_cast<std::size_t>(p * double(values.size() - 1))]; };
+        EXPECT_EQ(q.at(k), (std::vector<int>{at(0.99), at(0.5), values.front(), values.back(), at(0.5)})) << k;
+    }
+
+    bykey::thread_pool pool(3);
+    EXPECT_EQ(bykey::quantiles_by(pool, xs, bucket, std::identity{}, {0.99, 0.5, 0.0, 1.0, 0.5}), q);
+    EXPECT_THROW(bykey::quantiles_by(xs, bucket, std::identity{}, {1.5}), std::invalid_argument);
+}
+
+TEST(ByKey, HistogramByFixedBins) {
+    struct Sample { std::string service; double ms; };
+    std::vector<Sample> samples{{"api", 0.5}, {"api", 3}, {"db", 12}, {"api", 10}, {"db", 250}, {"api", -1}, {"db", 99.9}};
+    auto service = [](Sample const& s) { return s.service; };
+    auto ms = [](Sample const& s) { return s.ms; };
+
+    auto h = bykey::histogram_by(samples, service, ms, {0.0, 1.0, 10.0, 100.0});
+    EXPECT_EQ(h.keys, (std::vector<std::string>{"api", "db"}));
+    EXPECT_EQ(h.bins(), 5u);
+    auto api = h.row(0);
+    EXPECT_EQ(std::vector<std::size_t>(api.begin(), api.end()), (std::vector<std::size_t>{1, 1, 1, 1, 0}));
+    auto db = h.row(1);
+    EXPECT_EQ(std::vector<std::size_t>(db.begin(), db.end()), (std::vector<std::size_t>{0, 0, 0, 2, 1}));
+
+    std::vector<double> many_edges;
+    for (int i = 0; i <= 100; ++i) many_edges.push_back(i * 2.0);
+    std::vector<double> xs;
+    for (int i = 0; i < 1000; ++i) xs.push_back(i * 0.25 - 10);
+    auto one = [](double) { return 0; };
+    auto searched = bykey::histogram_by(xs, one, std::identity{}, many_edges);
+    auto uniform  = bykey::histogram_by(xs, one, std::identity{}, 0.0, 200.0, 100);
+    EXPECT_EQ(searched.counts, uniform.counts);
+    EXPECT_EQ(uniform.edges, many_edges);
+    EXPECT_EQ(uniform.counts.front(), 40u);
+    EXPECT_EQ(uniform.counts[1], 8u);
+    EXPECT_EQ(uniform.counts.back(), 160u);
+
+    // Values exactly on the reported edges land where those edges say.
+    std::vector<double> on_edges{0.0, 0.1, 0.2, 0.3, 0.4, 0.5, 0.6, 0.7, 0.8, 0.9, 1.0};
+    auto tenths = bykey::histogram_by(on_edges, one, std::identity{}, 0.0, 1.0, 10);
+    auto tenths_explicit = bykey::histogram_by(on_edges, one, std::identity{}, tenths.edges);
+    EXPECT_EQ(tenths.counts, tenths_explicit.counts);
+    std::vector<double> reported(tenths.edges);
+    auto reported_explicit = bykey::histogram_by(reported, one, std::identity{}, 0.0, 1.0, 10);
+    EXPECT_EQ(reported_explicit.counts, bykey::histogram_by(reported, one, std::identity{}, tenths.edges).counts);
+    EXPECT_EQ(reported_explicit.counts, (std::vector<std::size_t>{0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1}));
+
+    EXPECT_THROW(bykey::histogram_by(samples, service, ms, {5.0, 1.0}), std::invalid_argument);
+}
+
+TEST(ByKey, WelfordAndMomentsTraits) {
+    std::vector<double> xs{2, 4, 4, 4, 5, 5, 7, 9, 1e9 + 1, 1e9 + 3};
+    auto bucket = [](double x) { return x > 100 ? 1 : 0; };
+
+    auto stats = bykey::transform_reduce_by(xs, bucket, std::identity{}, bykey::welford_traits{});
+    EXPECT_EQ(stats.at(0).count, 8u);
+    EXPECT_DOUBLE_EQ(stats.at(0).mean, 5.0);
+    EXPECT_DOUBLE_EQ(stats.at(0).population_variance, 4.0);
+    EXPECT_DOUBLE_EQ(stats.at(0).variance, 32.0 / 7);
+    EXPECT_DOUBLE_EQ(stats.at(1).variance, 2.0);
+
+    bykey::welford_traits w;
+    auto left = w.identity(), right = w.identity();
+    for (int i = 0; i < 3; ++i) w.combine(left, xs[static_cast<std::size_t>(i)]);
+    for (int i = 3; i < 8; ++i) w.combine(right, xs[static_cast<std::size_t>(i)]);
+    w.merge(left, std::move(right));
+    EXPECT_DOUBLE_EQ(w.finalize(left).variance, 32.0 / 7);
+
+    std::vector<double> skewed{1, 2, 2, 3, 3, 3, 10, 0, 4, 8};
+    bykey::moments_traits m;
+    auto whole = m.identity(), a = m.identity(), b = m.identity();
+    for (std::size_t i = 0; i < skewed.size(); ++i) {
+        m.combine(whole, skewed[i]);
+        m.combine(i < 4 ? a : b, skewed[i]);
+    }
+    m.merge(a, std::move(b));
+    auto direct = m.finalize(whole), merged = m.finalize(a);
+    EXPECT_NEAR(direct.skewness, 1.080157, 1e-6);
+    EXPECT_NEAR(direct.kurtosis, 0.053884, 1e-6);
+    EXPECT_NEAR(merged.skewness, direct.skewness, 1e-12);
+    EXPECT_NEAR(merged.kurtosis, direct.kurtosis, 1e-12);
+    EXPECT_NEAR(merged.variance, direct.variance, 1e-12);
+
+    std::vector<int> keys{0, 0, 0, 1, 1, 0, 0, 0, 0, 1};
+    auto cols = bykey::welford_by_columns(keys, xs);
+    EXPECT_EQ(cols.keys, (std::vector<int>{0, 1}));
+    auto rows = bykey::transform_reduce_by(std::views::iota(std::size_t{0}, xs.size()),
+                                           [&](std::size_t i) { return keys[i]; },
+                                           [&](std::size_t i) { return xs[i]; }, bykey::welford_traits{});
+    for (std::size_t g = 0; g < 2; ++g) {
+        EXPECT_EQ(cols.values[g].count, rows.at(cols.keys[g]).count);
+        EXPECT_NEAR(cols.values[g].mean, rows.at(cols.keys[g]).mean, 1e-6);
+        EXPECT_NEAR(cols.values[g].variance, rows.at(cols.keys[g]).variance, 1e-6 * rows.at(cols.keys[g]).variance);
+    }
+}
+
 TEST(Examples, LC0049_GroupAnagrams) {
     std::vector<std::string> words{"eat","tea","tan","ate","nat","bat"};
     auto groups = bykey::group_by(
@@ -341,27 +1462,12 @@ TEST(Examples, LC0350_IntersectionWithMultiplicity) {
 }
 
 TEST(Examples, LC0242_ValidAnagram) {
-    EXPECT_TRUE(bykey::count_by(std::string{"anagram"}, [](char c){ return c; }) ==
-                bykey::count_by(std::string{"nagaram"}, [](char c){ return c; }));
-    EXPECT_FALSE(bykey::count_by(std::string{"rat"}, [](char c){ return c; }) ==
-                 bykey::count_by(std::string{"car"}, [](char c){ return c; }));
+    EXPECT_TRUE(bykey::equal_counts_by(std::string{"anagram"}, std::string{"nagaram"}, [](char c){ return c; }));
+    EXPECT_FALSE(bykey::equal_counts_by(std::string{"rat"}, std::string{"car"}, [](char c){ return c; }));
 }
 
 TEST(Examples, LC1331_RankTransform) {
     std::vector<int> arr{40, 10, 20, 30};
-    std::vector<int> uniq = arr;
-    std::sort(uniq.begin(), uniq.end());
-    uniq.erase(std::unique(uniq.begin(), uniq.end()), uniq.end());
-
-    auto ranks = bykey::index_by(
-        uniq,
-        [](int x){ return x; },
-        [next = 1](int) mutable { return next++; }
-    );
-
-    std::vector<int> result;
-    result.reserve(arr.size());
-    for (int x : arr) result.push_back(ranks.at(x));
-
-    EXPECT_EQ(result, (std::vector<int>{4,1,2,3}));
+    auto ranks = bykey::dense_rank_by(arr, [](int x){ return x; });
+    EXPECT_EQ(ranks, (std::vector<std::size_t>{4, 1, 2, 3}));
 }